@@ -48,6 +48,12 @@ void tickit_evloop_invoke_processwatch(TickitWatch *watch, TickitEventFlags flag
 void tickit_evloop_invoke_sigwatches(Tickit *t, int signum);
 void tickit_evloop_sigwinch(Tickit *t);
 
+/* Optional; called around blocking and after dispatching, to gather
+ * TICKIT_CTL_LOOPSTATS */
+void tickit_evloop_poll_begin(Tickit *t);
+void tickit_evloop_poll_end(Tickit *t);
+void tickit_evloop_iteration_end(Tickit *t);
+
 Tickit *tickit_new_with_evloop(TickitTerm *tt, TickitEventHooks *evhooks, void *initdata);
 
 #endif
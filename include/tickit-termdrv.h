@@ -47,6 +47,7 @@ void *tickit_termdrv_get_tmpbuffer(TickitTermDriver *ttd, size_t len);
 void tickit_termdrv_write_str(TickitTermDriver *ttd, const char *str, size_t len);
 void tickit_termdrv_write_strf(TickitTermDriver *ttd, const char *fmt, ...);
 TickitPen *tickit_termdrv_current_pen(TickitTermDriver *ttd);
+void tickit_termdrv_caps_changed(TickitTermDriver *ttd);
 
 /*
  * Intended for "subclass" terminal methods, to obtain their custom driver
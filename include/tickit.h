@@ -42,6 +42,7 @@ typedef struct TickitRectSet TickitRectSet;
 typedef struct TickitRenderBuffer TickitRenderBuffer;
 typedef struct TickitString TickitString;
 typedef struct TickitTerm TickitTerm;
+typedef struct TickitViewport TickitViewport;
 typedef struct TickitWindow TickitWindow;
 
 typedef struct Tickit Tickit;
@@ -72,6 +73,9 @@ typedef enum {
 
 typedef enum {
   TICKIT_CTL_USE_ALTSCREEN = 1,
+  TICKIT_CTL_WORKER_THREADS,
+  TICKIT_CTL_LOOPSTATS,
+  TICKIT_CTL_RESIZE_THROTTLE_MSEC,
 
   TICKIT_N_CTLS
 } TickitCtl;
@@ -175,6 +179,9 @@ typedef enum {
   TICKIT_TERMCTL_ICONTITLE_TEXT,
   TICKIT_TERMCTL_KEYPAD_APP,
   TICKIT_TERMCTL_COLORS, // read-only
+  TICKIT_TERMCTL_PASTE_BRACKETED,
+  TICKIT_TERMCTL_TEXT_BATCH,
+  TICKIT_TERMCTL_MOUSE_COALESCE,
 
   TICKIT_N_TERMCTLS
 } TickitTermCtl;
@@ -200,6 +207,11 @@ typedef enum {
   TICKIT_WINCTL_CURSORVIS,
   TICKIT_WINCTL_CURSORBLINK,
   TICKIT_WINCTL_CURSORSHAPE,
+  TICKIT_WINCTL_CHILD_INDEX,
+  TICKIT_WINCTL_DAMAGE_MERGE_RECTS,
+  TICKIT_WINCTL_DAMAGE_EXPOSE_COST,
+  TICKIT_WINCTL_CACHED,
+  TICKIT_WINCTL_INPUT_DEFER_MSEC,
 
   TICKIT_N_WINCTLS
 } TickitWindowCtl;
@@ -256,12 +268,64 @@ typedef struct {
 typedef enum {
   TICKIT_KEYEV_KEY = 1,
   TICKIT_KEYEV_TEXT,
+  TICKIT_KEYEV_PASTE,
 } TickitKeyEventType;
 
+/* Numeric key codes. Unicode keys are identified by their codepoint; other
+ * keys by values beyond the Unicode range.
+ */
+typedef enum {
+  TICKIT_KEY_NONE = 0,
+
+  TICKIT_KEY_BACKSPACE = 0x110000,
+  TICKIT_KEY_TAB,
+  TICKIT_KEY_ENTER,
+  TICKIT_KEY_ESCAPE,
+  TICKIT_KEY_SPACE,
+  TICKIT_KEY_DEL,
+  TICKIT_KEY_UP,
+  TICKIT_KEY_DOWN,
+  TICKIT_KEY_LEFT,
+  TICKIT_KEY_RIGHT,
+  TICKIT_KEY_BEGIN,
+  TICKIT_KEY_FIND,
+  TICKIT_KEY_INSERT,
+  TICKIT_KEY_DELETE,
+  TICKIT_KEY_SELECT,
+  TICKIT_KEY_PAGEUP,
+  TICKIT_KEY_PAGEDOWN,
+  TICKIT_KEY_HOME,
+  TICKIT_KEY_END,
+  TICKIT_KEY_KP0,
+  TICKIT_KEY_KP1,
+  TICKIT_KEY_KP2,
+  TICKIT_KEY_KP3,
+  TICKIT_KEY_KP4,
+  TICKIT_KEY_KP5,
+  TICKIT_KEY_KP6,
+  TICKIT_KEY_KP7,
+  TICKIT_KEY_KP8,
+  TICKIT_KEY_KP9,
+  TICKIT_KEY_KPENTER,
+  TICKIT_KEY_KPPLUS,
+  TICKIT_KEY_KPMINUS,
+  TICKIT_KEY_KPMULT,
+  TICKIT_KEY_KPDIV,
+  TICKIT_KEY_KPCOMMA,
+  TICKIT_KEY_KPPERIOD,
+  TICKIT_KEY_KPEQUALS,
+  TICKIT_KEY_OTHER, /* a named key without a code of its own */
+
+  TICKIT_KEY_F0 = 0x110100,
+} TickitKeyCode;
+
+#define TICKIT_KEY_F(n)  (TICKIT_KEY_F0 + (n))
+
 typedef struct {
   TickitKeyEventType type;
   int mod;
   const char *str;
+  int code; /* TickitKeyCode, or 0 if not known */
 } TickitKeyEventInfo;
 
 typedef enum {
@@ -286,6 +350,7 @@ typedef struct {
   int button;
   int mod;
   int line, col;
+  int count; /* number of wheel steps for TICKIT_MOUSEEV_WHEEL */
 } TickitMouseEventInfo;
 
 typedef struct {
@@ -296,6 +361,7 @@ typedef struct {
 typedef struct {
   TickitRect rect;
   TickitRenderBuffer *rb;
+  const TickitRectSet *visible;
 } TickitExposeEventInfo;
 
 typedef enum {
@@ -408,9 +474,11 @@ size_t tickit_rectset_get_rect(const TickitRectSet *trs, size_t i, TickitRect *r
 size_t tickit_rectset_get_rects(const TickitRectSet *trs, TickitRect rects[], size_t n);
 
 void tickit_rectset_add(TickitRectSet *trs, const TickitRect *rect);
+void tickit_rectset_add_rects(TickitRectSet *trs, const TickitRect rects[], size_t n);
 void tickit_rectset_subtract(TickitRectSet *trs, const TickitRect *rect);
 
 void tickit_rectset_translate(TickitRectSet *trs, int downward, int rightward);
+void tickit_rectset_translate_within(TickitRectSet *trs, const TickitRect *clip, int downward, int rightward);
 
 bool tickit_rectset_intersects(const TickitRectSet *trs, const TickitRect *rect);
 bool tickit_rectset_contains(const TickitRectSet *trs, const TickitRect *rect);
@@ -449,6 +517,9 @@ struct TickitTermBuilder {
   void                 *output_func_user;
 
   size_t output_buffersize;
+  size_t input_buffersize;
+
+  bool capcache; /* start with capabilities probed by an earlier run */
 
   /* Fields below here are undocumented and for vaguely internal or
    * special-case purposes
@@ -494,6 +565,7 @@ void tickit_term_set_utf8(TickitTerm *tt, bool utf8);
 
 void tickit_term_input_push_bytes(TickitTerm *tt, const char *bytes, size_t len);
 void tickit_term_input_readable(TickitTerm *tt);
+bool tickit_term_input_pending(TickitTerm *tt);
 int  tickit_term_input_check_timeout_msec(TickitTerm *tt);
 void tickit_term_input_wait_msec(TickitTerm *tt, long msec);
 void tickit_term_input_wait_tv(TickitTerm *tt, const struct timeval *timeout);
@@ -511,6 +583,7 @@ typedef enum {
   TICKIT_TERM_ON_RESIZE,
   TICKIT_TERM_ON_KEY,
   TICKIT_TERM_ON_MOUSE,
+  TICKIT_TERM_ON_CAPSCHANGE,
 } TickitTermEvent;
 
 int  tickit_term_bind_event(TickitTerm *tt, TickitTermEvent ev, TickitBindFlags flags,
@@ -721,6 +794,10 @@ int  tickit_window_bind_event(TickitWindow *win, TickitWindowEvent ev, TickitBin
     TickitWindowEventFn *fn, void *user);
 void tickit_window_unbind_event_id(TickitWindow *win, int id);
 
+int  tickit_window_bind_key(TickitWindow *win, const char *key, int mod, TickitBindFlags flags,
+    TickitWindowEventFn *fn, void *user);
+void tickit_window_unbind_key_id(TickitWindow *win, int id);
+
 void tickit_window_raise(TickitWindow *win);
 void tickit_window_raise_to_front(TickitWindow *win);
 void tickit_window_lower(TickitWindow *win);
@@ -778,6 +855,31 @@ DEPRECATED TickitWindowCtl tickit_window_lookup_ctl(const char *name);
 
 DEPRECATED TickitType tickit_window_ctltype(TickitWindowCtl ctl);
 
+/* Viewport */
+
+typedef struct {
+  int row;
+  int left;
+  int cols;
+  TickitRenderBuffer *rb;
+} TickitViewportRowInfo;
+
+typedef void TickitViewportRowFn(TickitViewport *vp, const TickitViewportRowInfo *info, void *user);
+
+TickitViewport *tickit_viewport_new(TickitWindow *win, TickitViewportRowFn *fn, void *user);
+void tickit_viewport_destroy(TickitViewport *vp);
+
+TickitWindow *tickit_viewport_get_window(const TickitViewport *vp);
+
+void tickit_viewport_get_content_size(const TickitViewport *vp, int *lines, int *cols);
+void tickit_viewport_set_content_size(TickitViewport *vp, int lines, int cols);
+
+void tickit_viewport_get_scroll(const TickitViewport *vp, int *line, int *col);
+void tickit_viewport_scroll_to(TickitViewport *vp, int line, int col);
+void tickit_viewport_scroll(TickitViewport *vp, int downward, int rightward);
+
+void tickit_viewport_expose_rows(TickitViewport *vp, int row, int count);
+
 /* Main object */
 
 typedef int TickitCallbackFn(Tickit *t, TickitEventFlags flags, void *info, void *user);
@@ -840,8 +942,43 @@ void *tickit_watch_signal(Tickit *t, int signum, TickitBindFlags flags, TickitCa
 
 void *tickit_watch_process(Tickit *t, pid_t pid, TickitBindFlags flags, TickitCallbackFn *fn, void *user);
 
+/* fn is invoked on a worker thread; fn_done later on the event loop */
+typedef void TickitWorkFn(void *user);
+void *tickit_watch_work(Tickit *t, TickitBindFlags flags, TickitWorkFn *fn, TickitCallbackFn *fn_done, void *user);
+
 void tickit_watch_cancel(Tickit *t, void *watch);
 
+/* The only function that may be called from a thread other than the one
+ * running the event loop */
+bool tickit_post(Tickit *t, TickitBindFlags flags, TickitCallbackFn *fn, void *user);
+
+/* Event loop statistics, gathered while TICKIT_CTL_LOOPSTATS is enabled */
+
+typedef enum {
+  TICKIT_LOOPSTAT_ITERATION, /* dispatching, from waking to finishing */
+  TICKIT_LOOPSTAT_POLL,      /* blocked waiting for events */
+  TICKIT_LOOPSTAT_IO,        /* per callback of each watch type */
+  TICKIT_LOOPSTAT_TIMER,
+  TICKIT_LOOPSTAT_LATER,
+  TICKIT_LOOPSTAT_SIGNAL,
+  TICKIT_LOOPSTAT_PROCESS,
+  TICKIT_LOOPSTAT_WORK,
+
+  TICKIT_N_LOOPSTATS
+} TickitLoopStat;
+
+typedef struct {
+  unsigned long count;
+  unsigned long total_usec;
+  unsigned long p50_usec, p90_usec, p99_usec;
+  unsigned long max_usec;
+  TickitCallbackFn *slowest; /* the callback that took max_usec, if any */
+} TickitLoopStatInfo;
+
+bool tickit_get_loopstat(Tickit *t, TickitLoopStat stat, TickitLoopStatInfo *info);
+const char *tickit_loopstat_name(TickitLoopStat stat);
+void tickit_dump_loopstats(Tickit *t, FILE *fh);
+
 /* Debug support */
 
 void tickit_debug_init(void);
@@ -1,54 +1,166 @@
 #include "bindings.h"
 
+#include <limits.h>
 #include <stdlib.h>
 
 struct TickitBinding {
-  struct TickitBinding *next;
+  struct TickitBinding   *prev, *next; /* within its event's list */
+  struct TickitBinding   *next_dead;
   int                     id;
   int                     evindex;
+  int                     seq;
   TickitBindFlags         flags;
   TickitEventFn          *fn;
   void                   *data;
 };
 
+struct TickitBindingList {
+  struct TickitBinding *first, *last;
+};
+
 #define BINDING_ID_TOMBSTONE -1
 
-static void cleanup(struct TickitBindings *bindings)
+/* Returns the slot holding id, or -1 */
+static int byid_find(struct TickitBindings *bindings, int id)
 {
-  for(struct TickitBinding **bindp = &bindings->first; *bindp; /**/) {
-    struct TickitBinding *bind = *bindp;
-    if(bind->id != BINDING_ID_TOMBSTONE) {
-      bindp = &(*bindp)->next;
-      continue;
+  if(!bindings->byid_size)
+    return -1;
+
+  int mask = bindings->byid_size - 1;
+  for(int i = id & mask; bindings->byid[i]; i = (i + 1) & mask)
+    if(bindings->byid[i]->id == id)
+      return i;
+
+  return -1;
+}
+
+static void byid_place(struct TickitBinding **byid, int size, struct TickitBinding *bind)
+{
+  int mask = size - 1;
+  int i = bind->id & mask;
+  while(byid[i])
+    i = (i + 1) & mask;
+
+  byid[i] = bind;
+}
+
+/* Returns false only if there's no room for bind at all. A table that merely
+ * can't grow is left fuller than we'd like, but still works.
+ */
+static bool byid_insert(struct TickitBindings *bindings, struct TickitBinding *bind)
+{
+  if((bindings->byid_count + 1) * 4 > bindings->byid_size * 3) {
+    int oldsize = bindings->byid_size;
+    int newsize = oldsize ? oldsize * 2 : 16;
+    struct TickitBinding **new = calloc(newsize, sizeof(struct TickitBinding *));
+
+    if(new) {
+      for(int i = 0; i < oldsize; i++)
+        if(bindings->byid[i])
+          byid_place(new, newsize, bindings->byid[i]);
+
+      free(bindings->byid);
+      bindings->byid = new;
+      bindings->byid_size = newsize;
     }
+    else if(bindings->byid_count + 1 >= oldsize)
+      /* Keep at least one slot empty so probes still terminate */
+      return false;
+  }
 
-    *bindp = bind->next;
-    bind->next = NULL;
+  byid_place(bindings->byid, bindings->byid_size, bind);
+  bindings->byid_count++;
+  return true;
+}
+
+/* Linear probing lets us delete by shifting later entries of the same probe
+ * run back into the hole, rather than leaving tombstones in the table
+ */
+static void byid_remove_slot(struct TickitBindings *bindings, int i)
+{
+  int mask = bindings->byid_size - 1;
+
+  bindings->byid[i] = NULL;
+  bindings->byid_count--;
+
+  for(int j = (i + 1) & mask; bindings->byid[j]; j = (j + 1) & mask) {
+    int home = bindings->byid[j]->id & mask;
 
+    /* Entries whose home slot lies cyclically within (i, j] must stay put */
+    if(i <= j ? (home > i && home <= j) : (home > i || home <= j))
+      continue;
+
+    bindings->byid[i] = bindings->byid[j];
+    bindings->byid[j] = NULL;
+    i = j;
+  }
+}
+
+static void unlink_binding(struct TickitBindings *bindings, struct TickitBinding *bind)
+{
+  struct TickitBindingList *list = &bindings->events[bind->evindex];
+
+  if(bind->prev)
+    bind->prev->next = bind->next;
+  else
+    list->first = bind->next;
+
+  if(bind->next)
+    bind->next->prev = bind->prev;
+  else
+    list->last = bind->prev;
+}
+
+/* Removes the binding from lookup by ID; it stays linked into its event's
+ * list until any running iterations have finished
+ */
+static void kill_binding(struct TickitBindings *bindings, struct TickitBinding *bind, int slot)
+{
+  byid_remove_slot(bindings, slot);
+
+  bind->id = BINDING_ID_TOMBSTONE;
+  bind->next_dead = bindings->dead;
+  bindings->dead = bind;
+  bindings->needs_delete = true;
+}
+
+static void cleanup(struct TickitBindings *bindings)
+{
+  while(bindings->dead) {
+    struct TickitBinding *bind = bindings->dead;
+    bindings->dead = bind->next_dead;
+
+    unlink_binding(bindings, bind);
     free(bind);
   }
 
   bindings->needs_delete = false;
 }
 
+static struct TickitBinding *first_binding(struct TickitBindings *bindings, int evindex)
+{
+  if(evindex < 0 || evindex >= bindings->n_events)
+    return NULL;
+
+  return bindings->events[evindex].first;
+}
+
 void tickit_bindings_run_event(struct TickitBindings *bindings, void *owner, int evindex, void *info)
 {
   int was_iterating = bindings->is_iterating;
   bindings->is_iterating = true;
 
-  for(struct TickitBinding *bind = bindings->first; bind; bind = bind->next)
-    if(bind->evindex == evindex) {
-      TickitEventFlags flags = TICKIT_EV_FIRE;
-      if(bind->flags & TICKIT_BIND_ONESHOT) {
-        flags |= TICKIT_EV_UNBIND;
-        bind->id = BINDING_ID_TOMBSTONE;
-        bindings->needs_delete = true;
-      }
-      (*bind->fn)(owner, flags, info, bind->data);
-      /* TODO: if !was_iterating then actually we can just splice it out of
-       * the chain and free() it now.
-       */
+  for(struct TickitBinding *bind = first_binding(bindings, evindex); bind; bind = bind->next) {
+    if(bind->id == BINDING_ID_TOMBSTONE)
+      continue;
+
+    TickitEventFlags flags = TICKIT_EV_FIRE;
+    if(bind->flags & TICKIT_BIND_ONESHOT) {
+      flags |= TICKIT_EV_UNBIND;
+      kill_binding(bindings, bind, byid_find(bindings, bind->id));
     }
+    (*bind->fn)(owner, flags, info, bind->data);
+  }
 
   bindings->is_iterating = was_iterating;
   if(!was_iterating && bindings->needs_delete)
@@ -62,14 +174,15 @@ int tickit_bindings_run_event_whilefalse(struct TickitBindings *bindings, void *
 
   int ret = 0;
 
-  for(struct TickitBinding *bind = bindings->first; bind; bind = bind->next)
-    if(bind->evindex == evindex) {
-      ret = (*bind->fn)(owner, TICKIT_EV_FIRE, info, bind->data);
-      if(ret)
-        goto exit;
-    }
+  for(struct TickitBinding *bind = first_binding(bindings, evindex); bind; bind = bind->next) {
+    if(bind->id == BINDING_ID_TOMBSTONE)
+      continue;
+
+    ret = (*bind->fn)(owner, TICKIT_EV_FIRE, info, bind->data);
+    if(ret)
+      break;
+  }
 
-exit:
   bindings->is_iterating = was_iterating;
   if(!was_iterating && bindings->needs_delete)
     cleanup(bindings);
@@ -79,86 +192,151 @@ exit:
 int tickit_bindings_bind_event(struct TickitBindings *bindings, void *owner, int evindex, TickitBindFlags flags,
     TickitEventFn *fn, void *data)
 {
-  int max_id = 0;
+  if(evindex >= bindings->n_events) {
+    struct TickitBindingList *events = realloc(bindings->events, (evindex + 1) * sizeof(struct TickitBindingList));
+    if(!events)
+      return -1;
+
+    bindings->events = events;
+    for(int i = bindings->n_events; i <= evindex; i++)
+      bindings->events[i] = (struct TickitBindingList){ NULL };
+    bindings->n_events = evindex + 1;
+  }
+
+  struct TickitBinding *bind = malloc(sizeof(struct TickitBinding));
+  if(!bind)
+    return -1;
+
+  /* IDs are never reused while a binding still holds them, even once the
+   * counter wraps
+   */
+  do {
+    if(bindings->next_id == INT_MAX)
+      bindings->next_id = 0;
+    bind->id = ++bindings->next_id;
+  } while(byid_find(bindings, bind->id) != -1);
 
-  struct TickitBinding **newp = &bindings->first;
-  struct TickitBinding *next = NULL;
+  if(!byid_insert(bindings, bind)) {
+    free(bind);
+    return -1;
+  }
+
+  bind->evindex = evindex;
+  bind->flags = flags & (TICKIT_BIND_UNBIND|TICKIT_BIND_DESTROY|TICKIT_BIND_ONESHOT);
+  bind->fn = fn;
+  bind->data = data;
+
+  struct TickitBindingList *list = &bindings->events[evindex];
 
   if(flags & TICKIT_BIND_FIRST) {
-    next = bindings->first;
-    for(struct TickitBinding *bind = *newp; bind; bind = bind->next)
-      if(bind->id > max_id)
-        max_id = bind->id;
+    bind->seq = --bindings->first_seq;
+    bind->prev = NULL;
+    bind->next = list->first;
+    if(list->first)
+      list->first->prev = bind;
+    else
+      list->last = bind;
+    list->first = bind;
   }
   else {
-    for(; *newp; newp = &(*newp)->next)
-      if((*newp)->id > max_id)
-        max_id = (*newp)->id;
+    bind->seq = ++bindings->last_seq;
+    bind->prev = list->last;
+    bind->next = NULL;
+    if(list->last)
+      list->last->next = bind;
+    else
+      list->first = bind;
+    list->last = bind;
   }
 
-  *newp = malloc(sizeof(struct TickitBinding)); // TODO: malloc failure
-
-  (*newp)->next = next;
-  (*newp)->evindex = evindex;
-  (*newp)->flags = flags & (TICKIT_BIND_UNBIND|TICKIT_BIND_DESTROY|TICKIT_BIND_ONESHOT);
-  (*newp)->fn = fn;
-  (*newp)->data = data;
-
-  return (*newp)->id = max_id + 1;
+  return bind->id;
 }
 
 void tickit_bindings_unbind_event_id(struct TickitBindings *bindings, void *owner, int id)
 {
-  for(struct TickitBinding **bindp = &bindings->first; *bindp; ) {
-    struct TickitBinding *bind = *bindp;
-    if(bind->id != id) {
-      bindp = &(bind->next);
-      continue;
-    }
+  int slot = byid_find(bindings, id);
+  if(slot == -1)
+    return;
 
-    if(bind->flags & TICKIT_EV_UNBIND)
-      (*bind->fn)(owner, TICKIT_EV_UNBIND, NULL, bind->data);
+  struct TickitBinding *bind = bindings->byid[slot];
 
-    // zero out the structure
-    bind->evindex = -1;
-    bind->fn = NULL;
+  if(bind->flags & TICKIT_EV_UNBIND) {
+    (*bind->fn)(owner, TICKIT_EV_UNBIND, NULL, bind->data);
 
-    if(!bindings->is_iterating) {
-      *bindp = bind->next;
-      bind->next = NULL;
-
-      free(bind);
-      /* no bindp update */
-    }
-    else {
-      bindings->needs_delete = true;
+    /* The handler may have bound or unbound others, moving this one */
+    slot = byid_find(bindings, id);
+    if(slot == -1)
+      return;
+  }
 
-      bind->id = BINDING_ID_TOMBSTONE;
-      bindp = &(bind->next);
-    }
+  if(!bindings->is_iterating) {
+    byid_remove_slot(bindings, slot);
+    unlink_binding(bindings, bind);
+    free(bind);
   }
+  else
+    kill_binding(bindings, bind, slot);
+}
+
+bool tickit_bindings_has_event(const struct TickitBindings *bindings, int evindex)
+{
+  return evindex >= 0 && evindex < bindings->n_events &&
+    bindings->events[evindex].first;
+}
+
+static void destroy_binding(struct TickitBinding *bind, void *owner)
+{
+  if(bind->evindex == 0 ||
+      bind->flags & (TICKIT_EV_UNBIND|TICKIT_EV_DESTROY))
+    (*bind->fn)(owner, TICKIT_EV_UNBIND|TICKIT_EV_DESTROY, NULL, bind->data);
+}
+
+static int cmp_seq_reverse(const void *a, const void *b)
+{
+  const struct TickitBinding *bind_a = *(struct TickitBinding * const *)a;
+  const struct TickitBinding *bind_b = *(struct TickitBinding * const *)b;
+
+  return (bind_a->seq < bind_b->seq) - (bind_a->seq > bind_b->seq);
 }
 
 void tickit_bindings_unbind_and_destroy(struct TickitBindings *bindings, void *owner)
 {
-  /* TICKIT_EV_DESTROY events need to run in reverse order. Since the bindings
-   * is singly-linked it is easiest just to reverse it then iterate.
+  /* TICKIT_EV_DESTROY events need to run in the reverse of the order the
+   * bindings would run in, across all the events
    */
-  struct TickitBinding *revbinds = NULL;
-  for(struct TickitBinding *bind = bindings->first; bind; /**/) {
-    struct TickitBinding *this = bind;
-    bind = bind->next;
+  int n = bindings->byid_count;
+  struct TickitBinding **binds = n ? malloc(n * sizeof(struct TickitBinding *)) : NULL;
+  if(binds) {
+    n = 0;
+    for(int i = 0; i < bindings->byid_size; i++)
+      if(bindings->byid[i])
+        binds[n++] = bindings->byid[i];
 
-    this->next = revbinds;
-    revbinds = this;
-  }
+    qsort(binds, n, sizeof(struct TickitBinding *), &cmp_seq_reverse);
 
-  for(struct TickitBinding *bind = revbinds; bind;) {
-    struct TickitBinding *next = bind->next;
-    if(bind->evindex == 0 ||
-        bind->flags & (TICKIT_EV_UNBIND|TICKIT_EV_DESTROY))
-      (*bind->fn)(owner, TICKIT_EV_UNBIND|TICKIT_EV_DESTROY, NULL, bind->data);
-    free(bind);
-    bind = next;
+    for(int i = 0; i < n; i++)
+      destroy_binding(binds[i], owner);
+
+    free(binds);
   }
+  else if(n)
+    /* Without the room to sort them, at least keep each event's bindings in
+     * reverse order
+     */
+    for(int evindex = bindings->n_events - 1; evindex >= 0; evindex--)
+      for(struct TickitBinding *bind = bindings->events[evindex].last; bind; bind = bind->prev)
+        if(bind->id != BINDING_ID_TOMBSTONE)
+          destroy_binding(bind, owner);
+
+  for(int evindex = 0; evindex < bindings->n_events; evindex++)
+    for(struct TickitBinding *bind = bindings->events[evindex].first; bind; /**/) {
+      struct TickitBinding *next = bind->next;
+      free(bind);
+      bind = next;
+    }
+
+  free(bindings->events);
+  free(bindings->byid);
+
+  *bindings = (struct TickitBindings){ NULL };
 }
@@ -1,9 +1,24 @@
 #include "tickit.h"
 
 struct TickitBinding;
+struct TickitBindingList;
 
+/* Bindings are kept in one list per event index, and are also found by ID
+ * in an open-addressed hash table. Either representation starts out empty
+ * when the structure is zeroed.
+ */
 struct TickitBindings {
-  struct TickitBinding *first;
+  struct TickitBindingList *events; /* indexed by evindex */
+  int n_events;
+
+  struct TickitBinding **byid;
+  int byid_size, byid_count;
+
+  int next_id;
+  int first_seq, last_seq; /* bounds of the binding order over all events */
+
+  struct TickitBinding *dead; /* unbound while iterating; freed afterwards */
+
   int is_iterating : 1;
   int needs_delete : 1;
 };
@@ -19,7 +34,14 @@ void tickit_bindings_unbind_event_id(struct TickitBindings *bindings, void *owne
 
 void tickit_bindings_unbind_and_destroy(struct TickitBindings *bindings, void *owner);
 
+/* May return true for an event whose only bindings are being unbound */
+bool tickit_bindings_has_event(const struct TickitBindings *bindings, int evindex);
+
 #define DEFINE_BINDINGS_FUNCS(NAME,OWNER,EVENTFN)                                \
+  DEFINE_BINDINGS_BIND_FUNCS(NAME,OWNER,EVENTFN)                                 \
+  DEFINE_BINDINGS_RUN_FUNCS(OWNER)
+
+#define DEFINE_BINDINGS_BIND_FUNCS(NAME,OWNER,EVENTFN)                           \
   int tickit_##NAME##_bind_event(OWNER *owner, OWNER##Event evindex,             \
       TickitBindFlags flags, EVENTFN *fn, void *data)                            \
   {                                                                              \
@@ -30,8 +52,9 @@ void tickit_bindings_unbind_and_destroy(struct TickitBindings *bindings, void *o
   void tickit_##NAME##_unbind_event_id(OWNER *owner, int id)                     \
   {                                                                              \
     tickit_bindings_unbind_event_id(&owner->bindings, owner, id);                   \
-  }                                                                              \
-                                                                                 \
+  }
+
+#define DEFINE_BINDINGS_RUN_FUNCS(OWNER)                                         \
   static inline void run_events(OWNER *owner, int evindex,                       \
       void *info)                                                                \
   {                                                                              \
@@ -0,0 +1,209 @@
+#ifdef __GLIBC__
+/* We need mkstemp() */
+#  define _XOPEN_SOURCE 700
+#endif
+
+#include "capcache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+/* Stored one line per terminal, as the key then a tab then the caps in hex.
+ * Most recently stored entries come first, and only the first few are kept.
+ */
+#define CAPCACHE_MAX_ENTRIES 32
+#define CAPCACHE_LINE_MAX    1024
+
+static char *cache_dir(void)
+{
+  const char *base = getenv("XDG_CACHE_HOME");
+  const char *suffix = "/tickit";
+
+  /* The spec says relative paths are to be ignored */
+  if(!base || base[0] != '/') {
+    base = getenv("HOME");
+    suffix = "/.cache/tickit";
+  }
+  if(!base || !base[0])
+    return NULL;
+
+  char *dir = malloc(strlen(base) + strlen(suffix) + 1);
+  if(!dir)
+    return NULL;
+
+  strcpy(dir, base);
+  strcat(dir, suffix);
+  return dir;
+}
+
+static char *cache_path(void)
+{
+  char *dir = cache_dir();
+  if(!dir)
+    return NULL;
+
+  char *path = realloc(dir, strlen(dir) + strlen("/caps") + 1);
+  if(!path) {
+    free(dir);
+    return NULL;
+  }
+
+  strcat(path, "/caps");
+  return path;
+}
+
+static void append_field(char *key, const char *value)
+{
+  size_t len = strlen(key);
+  key[len++] = '\t';
+
+  for(; value && *value; value++)
+    /* Keep the line structure intact */
+    key[len++] = (*value == '\t' || *value == '\n') ? ' ' : *value;
+
+  key[len] = 0;
+}
+
+char *tickit_capcache_key(const char *drivername, const char *termtype)
+{
+  const char *program = getenv("TERM_PROGRAM");
+  const char *version = getenv("TERM_PROGRAM_VERSION");
+
+  size_t len = strlen(drivername) + 4;
+  len += termtype ? strlen(termtype) : 0;
+  len += program  ? strlen(program)  : 0;
+  len += version  ? strlen(version)  : 0;
+
+  if(len >= CAPCACHE_LINE_MAX - 16)
+    return NULL;
+
+  char *key = malloc(len);
+  if(!key)
+    return NULL;
+
+  strcpy(key, drivername);
+  append_field(key, termtype);
+  append_field(key, program);
+  append_field(key, version);
+
+  return key;
+}
+
+/* Splits a cache line into its key and caps, returning false if malformed */
+static bool parse_line(char *line, char **key, unsigned int *caps)
+{
+  char *nl = strchr(line, '\n');
+  if(!nl)
+    return false;
+  *nl = 0;
+
+  char *tab = strrchr(line, '\t');
+  if(!tab)
+    return false;
+  *tab = 0;
+
+  char *end;
+  *caps = strtoul(tab + 1, &end, 16);
+  if(end == tab + 1 || *end)
+    return false;
+
+  *key = line;
+  return true;
+}
+
+bool tickit_capcache_load(const char *key, unsigned int *caps)
+{
+  char *path = cache_path();
+  if(!path)
+    return false;
+
+  FILE *f = fopen(path, "r");
+  free(path);
+  if(!f)
+    return false;
+
+  bool found = false;
+  char line[CAPCACHE_LINE_MAX];
+  while(!found && fgets(line, sizeof line, f)) {
+    char *linekey;
+    unsigned int linecaps;
+    if(parse_line(line, &linekey, &linecaps) && strcmp(linekey, key) == 0) {
+      *caps = linecaps;
+      found = true;
+    }
+  }
+
+  fclose(f);
+  return found;
+}
+
+void tickit_capcache_store(const char *key, unsigned int caps)
+{
+  char *dir = cache_dir();
+  if(!dir)
+    return;
+
+  /* Only the final component is ours to create; if the parent cache
+   * directory is missing too, create that much but no more
+   */
+  if(mkdir(dir, 0700) != 0 && errno == ENOENT) {
+    char *slash = strrchr(dir, '/');
+    *slash = 0;
+    mkdir(dir, 0700);
+    *slash = '/';
+    mkdir(dir, 0700);
+  }
+
+  char *path = cache_path();
+  char *tmppath = malloc(strlen(dir) + strlen("/caps.XXXXXX") + 1);
+  if(!path || !tmppath)
+    goto done;
+
+  /* Write the new file aside and rename it into place, so that concurrent
+   * readers never see it half-written
+   */
+  strcpy(tmppath, dir);
+  strcat(tmppath, "/caps.XXXXXX");
+
+  int fd = mkstemp(tmppath);
+  if(fd == -1)
+    goto done;
+
+  FILE *out = fdopen(fd, "w");
+  if(!out) {
+    close(fd);
+    unlink(tmppath);
+    goto done;
+  }
+
+  fprintf(out, "%s\t%x\n", key, caps);
+  int entries = 1;
+
+  FILE *in = fopen(path, "r");
+  if(in) {
+    char line[CAPCACHE_LINE_MAX];
+    while(entries < CAPCACHE_MAX_ENTRIES && fgets(line, sizeof line, in)) {
+      char *linekey;
+      unsigned int linecaps;
+      if(!parse_line(line, &linekey, &linecaps) || strcmp(linekey, key) == 0)
+        continue;
+
+      fprintf(out, "%s\t%x\n", linekey, linecaps);
+      entries++;
+    }
+    fclose(in);
+  }
+
+  if(fclose(out) != 0 || rename(tmppath, path) != 0)
+    unlink(tmppath);
+
+done:
+  free(tmppath);
+  free(path);
+  free(dir);
+}
@@ -0,0 +1,14 @@
+#include "tickit.h"
+
+/* A small persistent cache of probed terminal capabilities, so that a driver
+ * can use features found by an earlier run from the moment it starts, while
+ * it probes again in the background. Entries are keyed by the identity of the
+ * terminal: the driver, TERM, and the TERM_PROGRAM and TERM_PROGRAM_VERSION
+ * environment variables that terminal emulators commonly set. The caps value
+ * is a bitmask whose meaning is private to each driver.
+ */
+
+char *tickit_capcache_key(const char *drivername, const char *termtype);
+
+bool tickit_capcache_load(const char *key, unsigned int *caps);
+void tickit_capcache_store(const char *key, unsigned int caps);
@@ -1,25 +1,51 @@
 #include "tickit.h"
 
-#include <string.h> // memcpy, memmove
-
-struct TickitRectSet {
+#include <limits.h> // INT_MIN
+#include <string.h> // memcpy
+
+/* The regions are stored "y-x banded", in the style of X11 or pixman regions.
+ * Rects are sorted by top then left, and are grouped into bands of rects that
+ * all share the same top and bottom. Within a band the rects are disjoint and
+ * never touch horizontally, and two vertically-adjacent bands never have the
+ * same set of columns (they would have been coalesced into one band).
+ *
+ * This gives every set of cells exactly one representation, and lets the set
+ * operations be performed by a single linear merge of two band lists.
+ */
+
+typedef struct {
   TickitRect *rects;
   size_t      count;  /* How many we consider valid */
   size_t      size;   /* How many can fit in the allocated array */
+} RectArray;
+
+struct TickitRectSet {
+  RectArray boxes;
+  RectArray spare;  /* scratch space to build the result of an operation in */
 };
 
+typedef enum {
+  OP_UNION,
+  OP_SUBTRACT,
+  OP_INTERSECT,
+} RegionOp;
+
 TickitRectSet *tickit_rectset_new(void)
 {
   TickitRectSet *ret = malloc(sizeof(TickitRectSet));
   if(!ret)
     return NULL;
 
-  ret->size = 4;
-  ret->rects = malloc(ret->size * sizeof(ret->rects[0]));
-  if(!ret->rects)
+  ret->boxes.size = 4;
+  ret->boxes.rects = malloc(ret->boxes.size * sizeof(ret->boxes.rects[0]));
+  if(!ret->boxes.rects)
     goto abort_free;
 
-  ret->count = 0;
+  ret->boxes.count = 0;
+
+  ret->spare.rects = NULL;
+  ret->spare.count = 0;
+  ret->spare.size  = 0;
 
   return ret;
 
@@ -30,216 +56,491 @@ abort_free:
 
 void tickit_rectset_destroy(TickitRectSet *trs)
 {
-  free(trs->rects);
+  free(trs->boxes.rects);
+  free(trs->spare.rects);
   free(trs);
 }
 
 void tickit_rectset_clear(TickitRectSet *trs)
 {
-  trs->count = 0;
+  trs->boxes.count = 0;
 }
 
 size_t tickit_rectset_rects(const TickitRectSet *trs)
 {
-  return trs->count;
+  return trs->boxes.count;
 }
 
 size_t tickit_rectset_get_rect(const TickitRectSet *trs, size_t i, TickitRect *rect)
 {
-  if(i >= trs->count)
+  if(i >= trs->boxes.count)
     return 0;
 
-  memcpy(rect, trs->rects + i, sizeof(trs->rects[0]));
+  memcpy(rect, trs->boxes.rects + i, sizeof(trs->boxes.rects[0]));
   return 1;
 }
 
 size_t tickit_rectset_get_rects(const TickitRectSet *trs, TickitRect rects[], size_t n)
 {
-  if(n > trs->count)
-    n = trs->count;
+  if(n > trs->boxes.count)
+    n = trs->boxes.count;
 
-  memcpy(rects, trs->rects, n * sizeof(trs->rects[0]));
+  memcpy(rects, trs->boxes.rects, n * sizeof(trs->boxes.rects[0]));
   return n;
 }
 
-static int cmprect(const TickitRect *a, const TickitRect *b)
+static int cmprect(const void *_a, const void *_b)
 {
+  const TickitRect *a = _a, *b = _b;
+
   if(a->top != b->top)
     return a->top - b->top;
   return a->left - b->left;
 }
 
-static int insert_rect(TickitRectSet *trs, const TickitRect *r)
+static bool push_rect(RectArray *arr, int top, int bottom, int left, int right)
 {
-  if(trs->count + 1 > trs->size) {
-    TickitRect *newrects = realloc(trs->rects, trs->size * 2 * sizeof(trs->rects[0]));
+  if(arr->count + 1 > arr->size) {
+    size_t newsize = arr->size ? arr->size * 2 : 4;
+    TickitRect *newrects = realloc(arr->rects, newsize * sizeof(arr->rects[0]));
     if(!newrects)
-      return 0;
+      return false;
 
-    trs->rects = newrects;
-    trs->size *= 2;
+    arr->rects = newrects;
+    arr->size = newsize;
   }
 
-  /* TODO: binary search */
-  int idx;
-  for(idx = 0; idx < trs->count; idx++)
-    if(cmprect(trs->rects + idx, r) > 0)
-      break;
+  tickit_rect_init_bounded(arr->rects + arr->count, top, left, bottom, right);
+  arr->count++;
+  return true;
+}
 
-  memmove(trs->rects + idx + 1, trs->rects + idx, (trs->count - idx) * sizeof(trs->rects[0]));
-  trs->rects[idx] = *r;
-  trs->count++;
-  return 1;
+/* Returns the index just past the end of the band starting at index i */
+static size_t band_end(const TickitRect *rects, size_t i, size_t n)
+{
+  int top = rects[i].top;
+  while(i < n && rects[i].top == top)
+    i++;
+  return i;
 }
 
-static void delete_rect(TickitRectSet *trs, int idx)
+/* Returns the index of the first rect whose bottom is below the given line.
+ * Because bands do not overlap, bottoms never decrease along the array.
+ */
+static size_t first_below(const RectArray *arr, int line)
 {
-  memmove(trs->rects + idx, trs->rects + idx + 1, (trs->count - idx - 1) * sizeof(trs->rects[0]));
-  trs->count--;
+  size_t lo = 0, hi = arr->count;
+  while(lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if(tickit_rect_bottom(arr->rects + mid) > line)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
 }
 
-void tickit_rectset_add(TickitRectSet *trs, const TickitRect *rect)
+/* Returns the index of the first rect in the band [i, e) whose right edge is
+ * beyond the given column, or e if there is none.
+ */
+static size_t band_first_right_of(const TickitRect *rects, size_t i, size_t e, int col)
 {
-  int top    = rect->top;
-  int bottom = tickit_rect_bottom(rect);
-  int left   = rect->left;
-  int right  = tickit_rect_right(rect);
+  while(i < e) {
+    size_t mid = i + (e - i) / 2;
+    if(tickit_rect_right(rects + mid) > col)
+      e = mid;
+    else
+      i = mid + 1;
+  }
+  return i;
+}
+
+/* The band just appended to arr starts at index cur; if it continues the
+ * previous band at *prev with exactly the same columns, merge them
+ */
+static void coalesce(RectArray *arr, size_t *prev, size_t cur)
+{
+  size_t n = arr->count - cur;
+  if(!n)
+    return;
+
+  if(*prev < cur && cur - *prev == n) {
+    TickitRect *p = arr->rects + *prev;
+    TickitRect *c = arr->rects + cur;
+
+    if(tickit_rect_bottom(p) == c->top) {
+      size_t i;
+      for(i = 0; i < n; i++)
+        if(p[i].left != c[i].left || p[i].cols != c[i].cols)
+          break;
+
+      if(i == n) {
+        for(i = 0; i < n; i++)
+          p[i].lines += c[0].lines;
+        arr->count = cur;
+        return;
+      }
+    }
+  }
 
-restart:
-  for(int i = 0; i < trs->count; i++) {
-    TickitRect *r = trs->rects + i;
-    int r_bottom = tickit_rect_bottom(r);
-    int r_right  = tickit_rect_right(r);
+  *prev = cur;
+}
+
+static bool append_band(RectArray *out, size_t *prev, const TickitRect *band, size_t n, int top, int bottom)
+{
+  size_t cur = out->count;
+
+  for(size_t i = 0; i < n; i++)
+    if(!push_rect(out, top, bottom, band[i].left, tickit_rect_right(band + i)))
+      return false;
+
+  coalesce(out, prev, cur);
+  return true;
+}
 
-    // Because the rects are ordered, there is no point continuing if we're
-    // already past it
-    if(bottom < r->top)
+static bool overlap_band(RectArray *out, size_t *prev, RegionOp op,
+    const TickitRect *a, const TickitRect *a_end, const TickitRect *b, const TickitRect *b_end,
+    int top, int bottom)
+{
+  size_t cur = out->count;
+
+  switch(op) {
+    case OP_UNION: {
+      bool have = false;
+      int left = 0, right = 0;
+
+      while(a < a_end || b < b_end) {
+        const TickitRect *next;
+        if(b == b_end || (a < a_end && a->left < b->left))
+          next = a++;
+        else
+          next = b++;
+
+        if(have && next->left <= right) {
+          if(tickit_rect_right(next) > right)
+            right = tickit_rect_right(next);
+          continue;
+        }
+
+        if(have && !push_rect(out, top, bottom, left, right))
+          return false;
+
+        left  = next->left;
+        right = tickit_rect_right(next);
+        have  = true;
+      }
+
+      if(have && !push_rect(out, top, bottom, left, right))
+        return false;
+      break;
+    }
+
+    case OP_SUBTRACT:
+      for(; a < a_end; a++) {
+        int left  = a->left;
+        int right = tickit_rect_right(a);
+
+        // Subtrahends entirely to the left of this rect can't affect any
+        // later ones either
+        while(b < b_end && tickit_rect_right(b) <= left)
+          b++;
+
+        for(const TickitRect *bb = b; bb < b_end && bb->left < right; bb++) {
+          if(bb->left > left &&
+             !push_rect(out, top, bottom, left, bb->left))
+            return false;
+
+          left = tickit_rect_right(bb);
+          if(left >= right)
+            break;
+        }
+
+        if(left < right && !push_rect(out, top, bottom, left, right))
+          return false;
+      }
+      break;
+
+    case OP_INTERSECT:
+      while(a < a_end && b < b_end) {
+        int a_right = tickit_rect_right(a);
+        int b_right = tickit_rect_right(b);
+
+        int left  = a->left > b->left ? a->left : b->left;
+        int right = a_right < b_right ? a_right : b_right;
+
+        if(left < right && !push_rect(out, top, bottom, left, right))
+          return false;
+
+        if(a_right <= b_right)
+          a++;
+        if(b_right <= a_right)
+          b++;
+      }
       break;
+  }
+
+  coalesce(out, prev, cur);
+  return true;
+}
+
+/* Appends the result of combining the banded regions a and b to out. Returns
+ * false if it ran out of memory; out is then left in an unspecified state
+ */
+static bool region_op(RectArray *out, RegionOp op,
+    const TickitRect *a, size_t na, const TickitRect *b, size_t nb)
+{
+  bool keep_a = (op != OP_INTERSECT);
+  bool keep_b = (op == OP_UNION);
+
+  size_t prev = out->count;
+  size_t ia = 0, ib = 0;
+
+  // Everything above this line has already been output
+  int ybot = INT_MIN;
 
-    if(top > r_bottom || left > r_right || right < r->left)
-      continue;
-
-    if(tickit_rect_contains(r, rect))
-      // Already entirely covered, just return
-      return;
-
-    int top_eq    = top    == r->top;
-    int bottom_eq = bottom == r_bottom;
-    int left_eq   = left   == r->left;
-    int right_eq  = right  == r_right;
-
-    if((top_eq && bottom_eq) || (left_eq && right_eq)) {
-      // Stretch an existing rectangle horizontally or vertically
-      // Tempting to think we can just do this in-place but needs to account
-      // for being able to merge multiple at once
-      if(r->top   < top)    top    = r->top;
-      if(r_bottom > bottom) bottom = r_bottom;
-      if(r->left  < left)   left   = r->left;
-      if(r_right  > right)  right  = r_right;
-
-      delete_rect(trs, i);
-      goto restart;
+  while(ia < na && ib < nb) {
+    size_t ea = band_end(a, ia, na);
+    size_t eb = band_end(b, ib, nb);
+
+    int a_top = a[ia].top, a_bottom = tickit_rect_bottom(a + ia);
+    int b_top = b[ib].top, b_bottom = tickit_rect_bottom(b + ib);
+
+    int ytop;
+
+    // Output any part of the upper band that sits above the other one
+    if(a_top < b_top) {
+      int top    = a_top > ybot ? a_top : ybot;
+      int bottom = a_bottom < b_top ? a_bottom : b_top;
+      if(keep_a && top < bottom &&
+         !append_band(out, &prev, a + ia, ea - ia, top, bottom))
+        return false;
+
+      ytop = b_top;
     }
+    else if(b_top < a_top) {
+      int top    = b_top > ybot ? b_top : ybot;
+      int bottom = b_bottom < a_top ? b_bottom : a_top;
+      if(keep_b && top < bottom &&
+         !append_band(out, &prev, b + ib, eb - ib, top, bottom))
+        return false;
 
-    if(top == r_bottom || bottom == r->top)
-      // No actual interaction, just add it. This case handles the recursion
-      // implied at the end of this loop
-      continue;
+      ytop = a_top;
+    }
+    else
+      ytop = a_top;
 
-    // Non-simple interaction. Split r and rect into the 2 or 3 separate rects
-    // it now must be composed of, delete r, then recurse on those to-be-added
-    // rects instead.
-    TickitRect to_add[3];
-    int n = tickit_rect_add(to_add, r, rect); // TODO: top/left/bottom/right ?
+    ybot = a_bottom < b_bottom ? a_bottom : b_bottom;
 
-    delete_rect(trs, i);
+    if(ybot > ytop &&
+       !overlap_band(out, &prev, op, a + ia, a + ea, b + ib, b + eb, ytop, ybot))
+      return false;
 
-    for(i = 0; i < n; i++)
-      tickit_rectset_add(trs, to_add + i);
-    return;
+    if(a_bottom == ybot)
+      ia = ea;
+    if(b_bottom == ybot)
+      ib = eb;
   }
 
-  // If we got this far then we need to add it
-  TickitRect new;
-  tickit_rect_init_bounded(&new, top, left, bottom, right);
+  // At most one of these has anything left
+  const TickitRect *rest = NULL;
+  size_t i = 0, n = 0;
+
+  if(ia < na && keep_a)
+    rest = a, i = ia, n = na;
+  else if(ib < nb && keep_b)
+    rest = b, i = ib, n = nb;
+
+  while(rest && i < n) {
+    size_t e = band_end(rest, i, n);
+    int top = rest[i].top > ybot ? rest[i].top : ybot;
+
+    if(!append_band(out, &prev, rest + i, e - i, top, tickit_rect_bottom(rest + i)))
+      return false;
+
+    i = e;
+  }
+
+  return true;
+}
+
+static void rectset_op(TickitRectSet *trs, RegionOp op, const TickitRect *rects, size_t n)
+{
+  trs->spare.count = 0;
 
   // TODO: error handling
-  insert_rect(trs, &new);
+  if(!region_op(&trs->spare, op, trs->boxes.rects, trs->boxes.count, rects, n))
+    return;
+
+  RectArray tmp = trs->boxes;
+  trs->boxes = trs->spare;
+  trs->spare = tmp;
 }
 
-void tickit_rectset_subtract(TickitRectSet *trs, const TickitRect *rect)
+void tickit_rectset_add(TickitRectSet *trs, const TickitRect *rect)
 {
-  for(int i = 0; i < trs->count; i++) {
-    TickitRect *r = trs->rects + i;
-    if(!tickit_rect_intersects(r, rect))
-      continue;
+  if(rect->lines <= 0 || rect->cols <= 0)
+    return;
+
+  if(tickit_rectset_contains(trs, rect))
+    return;
+
+  rectset_op(trs, OP_UNION, rect, 1);
+}
+
+void tickit_rectset_add_rects(TickitRectSet *trs, const TickitRect rects[], size_t n)
+{
+  // Each rect is a region by itself. Union neighbouring pairs of regions
+  // together until only one remains, then add that to the set. Sorting the
+  // rects first keeps the intermediate regions compact.
+  RectArray cur  = { NULL, 0, 0 };
+  RectArray next = { NULL, 0, 0 };
+  size_t *starts = NULL;
+
+  for(size_t i = 0; i < n; i++)
+    if(rects[i].lines > 0 && rects[i].cols > 0 &&
+       !push_rect(&cur, rects[i].top, tickit_rect_bottom(rects + i), rects[i].left, tickit_rect_right(rects + i)))
+      goto out;
 
-    TickitRect remains[4];
-    int n = tickit_rect_subtract(remains, r, rect);
+  if(!cur.count)
+    goto out;
 
-    delete_rect(trs, i);
-    i--;
+  qsort(cur.rects, cur.count, sizeof(cur.rects[0]), &cmprect);
 
-    // It doesn't matter if insert starts putting these before i; the worst
-    // that will happen is that a few rects that we inspected once just move
-    // underneath us and we have to inspect them a second time
-    int j;
-    for(j = 0; j < n; j++)
-      tickit_rectset_add(trs, remains + j);
+  size_t nregions = cur.count;
+
+  starts = malloc((nregions + 1) * sizeof(starts[0]));
+  if(!starts)
+    goto out;
+
+  for(size_t i = 0; i <= nregions; i++)
+    starts[i] = i;
+
+  while(nregions > 1) {
+    size_t nnext = 0;
+    next.count = 0;
+
+    for(size_t i = 0; i < nregions; i += 2) {
+      size_t a = starts[i], b = starts[i + 1];
+      size_t end = (i + 1 < nregions) ? starts[i + 2] : b;
+
+      starts[nnext++] = next.count;
+
+      if(!region_op(&next, OP_UNION, cur.rects + a, b - a, cur.rects + b, end - b))
+        goto out;
+    }
+
+    starts[nnext] = next.count;
+    nregions = nnext;
+
+    RectArray tmp = cur;
+    cur = next;
+    next = tmp;
   }
+
+  rectset_op(trs, OP_UNION, cur.rects, cur.count);
+
+out:
+  free(cur.rects);
+  free(next.rects);
+  free(starts);
+}
+
+void tickit_rectset_subtract(TickitRectSet *trs, const TickitRect *rect)
+{
+  if(!tickit_rectset_intersects(trs, rect))
+    return;
+
+  rectset_op(trs, OP_SUBTRACT, rect, 1);
 }
 
 void tickit_rectset_translate(TickitRectSet *trs, int downward, int rightward)
 {
-  for(int i = 0; i < trs->count; i++) {
-    trs->rects[i].top  += downward;
-    trs->rects[i].left += rightward;
+  for(int i = 0; i < trs->boxes.count; i++) {
+    trs->boxes.rects[i].top  += downward;
+    trs->boxes.rects[i].left += rightward;
+  }
+}
+
+void tickit_rectset_translate_within(TickitRectSet *trs, const TickitRect *clip, int downward, int rightward)
+{
+  if(!tickit_rectset_intersects(trs, clip))
+    return;
+
+  // Split out the part within the clip, move it, and clip it again
+  RectArray inside  = { NULL, 0, 0 };
+  RectArray moved   = { NULL, 0, 0 };
+
+  if(!region_op(&inside, OP_INTERSECT, trs->boxes.rects, trs->boxes.count, clip, 1))
+    goto out;
+
+  // Banding is unaffected by a uniform translation
+  for(size_t i = 0; i < inside.count; i++) {
+    inside.rects[i].top  += downward;
+    inside.rects[i].left += rightward;
   }
+
+  if(!region_op(&moved, OP_INTERSECT, inside.rects, inside.count, clip, 1))
+    goto out;
+
+  rectset_op(trs, OP_SUBTRACT, clip, 1);
+  rectset_op(trs, OP_UNION, moved.rects, moved.count);
+
+out:
+  free(inside.rects);
+  free(moved.rects);
 }
 
 bool tickit_rectset_intersects(const TickitRectSet *trs, const TickitRect *rect)
 {
-  for(int i = 0; i < trs->count; i++)
-    if(tickit_rect_intersects(trs->rects + i, rect))
+  if(rect->lines <= 0 || rect->cols <= 0)
+    return false;
+
+  const TickitRect *rects = trs->boxes.rects;
+  size_t count = trs->boxes.count;
+
+  int bottom = tickit_rect_bottom(rect);
+  int right  = tickit_rect_right(rect);
+
+  for(size_t i = first_below(&trs->boxes, rect->top); i < count && rects[i].top < bottom; /**/) {
+    size_t e = band_end(rects, i, count);
+
+    size_t j = band_first_right_of(rects, i, e, rect->left);
+    if(j < e && rects[j].left < right)
       return true;
 
+    i = e;
+  }
+
   return false;
 }
 
-bool tickit_rectset_contains(const TickitRectSet *trs, const TickitRect *rectptr)
+bool tickit_rectset_contains(const TickitRectSet *trs, const TickitRect *rect)
 {
-  // We might want to modify it
-  TickitRect rect = *rectptr;
-
-  for(int i = 0; i < trs->count; i++) {
-    TickitRect *r = trs->rects + i;
-    if(!tickit_rect_intersects(r, &rect))
-      continue;
-
-    // Because rects are in order, if there's any part of rect above or to
-    // the left of here we know we didn't match it
-    if(rect.top  < r->top ||
-       rect.left < r->left)
-      return false;
+  if(rect->lines <= 0 || rect->cols <= 0)
+    return false;
 
-    int r_bottom = tickit_rect_bottom(r);
-    int rect_bottom = tickit_rect_bottom(&rect);
+  const TickitRect *rects = trs->boxes.rects;
+  size_t count = trs->boxes.count;
 
-    if(rect.top < r_bottom && r_bottom < rect_bottom) {
-      int rect_right = tickit_rect_right(&rect);
+  int bottom = tickit_rect_bottom(rect);
+  int right  = tickit_rect_right(rect);
 
-      TickitRect lower;
-      tickit_rect_init_bounded(&lower, r_bottom, rect.left, rect_bottom, rect_right);
+  // Every line of rect must be covered by a run of consecutive bands, each of
+  // which has a single rect spanning all of its columns
+  size_t i = first_below(&trs->boxes, rect->top);
+  for(int line = rect->top; line < bottom; /**/) {
+    if(i >= count || rects[i].top > line)
+      return false;
 
-      if(!tickit_rectset_contains(trs, &lower))
-        return false;
+    size_t e = band_end(rects, i, count);
 
-      // tickit_rect_init_bounded(&rect, rect.top, rect.left, r_bottom, r_right)
-      rect.lines = r_bottom - rect.top;
-    }
+    size_t j = band_first_right_of(rects, i, e, rect->left);
+    if(j == e || rects[j].left > rect->left || tickit_rect_right(rects + j) < right)
+      return false;
 
-    return tickit_rect_contains(r, &rect);
+    line = tickit_rect_bottom(rects + i);
+    i = e;
   }
 
-  return false;
+  return true;
 }
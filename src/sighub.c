@@ -0,0 +1,196 @@
+/* We need sigaction() and struct sigaction */
+#ifdef __GLIBC__
+#  define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "sighub.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+
+/* POSIX doesn't actually define an NSIG macro, but if it did, almost every
+ * known platform would set it to 32
+ */
+#ifndef NSIG
+#  define NSIG 32
+#endif
+
+/* Signal sets the handler can update atomically, one bit per signal */
+#define SIGWORDS ((NSIG + 63) / 64)
+#define SIGWORD(signum) ((signum) / 64)
+#define SIGBIT(signum)  ((uint64_t)1 << ((signum) % 64))
+
+/* The handler may run on any thread at any time, so it walks the subscriber
+ * list without locking. That is safe because nodes are only ever prepended
+ * and are never freed; an unsubscribed node is just left idle for reuse.
+ */
+struct TickitSigSub {
+  TickitSigSub *next; /* never changes once published */
+
+  int wakefd;
+  uint64_t watched[SIGWORDS]; /* atomic */
+  uint64_t pending[SIGWORDS]; /* atomic */
+  int busy;         /* atomic; handlers currently looking at wakefd */
+  bool in_use;      /* guarded by lock */
+};
+
+static TickitSigSub *subscribers;
+
+/* Guards everything except what the handler touches */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int refcount[NSIG];
+static struct sigaction oldaction[NSIG];
+
+static void sighandler(int signum)
+{
+  int saved_errno = errno;
+
+  int word = SIGWORD(signum);
+  uint64_t bit = SIGBIT(signum);
+  TickitSigSub *sub = __atomic_load_n(&subscribers, __ATOMIC_ACQUIRE);
+  for(; sub; sub = sub->next) {
+    __atomic_add_fetch(&sub->busy, 1, __ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(&sub->watched[word], __ATOMIC_SEQ_CST) & bit) {
+      __atomic_fetch_or(&sub->pending[word], bit, __ATOMIC_SEQ_CST);
+
+      uint64_t one = 1;
+      write(sub->wakefd, &one, sizeof one);
+    }
+
+    __atomic_sub_fetch(&sub->busy, 1, __ATOMIC_SEQ_CST);
+  }
+
+  errno = saved_errno;
+}
+
+TickitSigSub *tickit_sighub_subscribe(int wakefd)
+{
+  pthread_mutex_lock(&lock);
+
+  TickitSigSub *sub;
+  for(sub = subscribers; sub; sub = sub->next)
+    if(!sub->in_use)
+      break;
+
+  if(!sub) {
+    sub = malloc(sizeof(TickitSigSub));
+    if(!sub)
+      goto out;
+
+    for(int word = 0; word < SIGWORDS; word++)
+      sub->watched[word] = 0;
+    sub->busy = 0;
+    sub->next    = subscribers;
+    __atomic_store_n(&subscribers, sub, __ATOMIC_RELEASE);
+  }
+
+  /* Not yet watching anything, so the handler won't look at these */
+  sub->wakefd = wakefd;
+  for(int word = 0; word < SIGWORDS; word++)
+    sub->pending[word] = 0;
+  sub->in_use = true;
+
+out:
+  pthread_mutex_unlock(&lock);
+  return sub;
+}
+
+static void release_signal(int signum)
+{
+  if(--refcount[signum])
+    return;
+
+  sigaction(signum, &oldaction[signum], NULL);
+}
+
+void tickit_sighub_unsubscribe(TickitSigSub *sub)
+{
+  pthread_mutex_lock(&lock);
+
+  uint64_t watched[SIGWORDS];
+  for(int word = 0; word < SIGWORDS; word++)
+    watched[word] = __atomic_exchange_n(&sub->watched[word], 0, __ATOMIC_SEQ_CST);
+
+  for(int signum = 1; signum < NSIG; signum++)
+    if(watched[SIGWORD(signum)] & SIGBIT(signum))
+      release_signal(signum);
+
+  /* Any handler that saw the old watched mask might still be about to write
+   * to wakefd; wait for it to finish before the caller closes it
+   */
+  while(__atomic_load_n(&sub->busy, __ATOMIC_SEQ_CST))
+    sched_yield();
+
+  sub->wakefd = -1;
+  sub->in_use = false;
+
+  pthread_mutex_unlock(&lock);
+}
+
+bool tickit_sighub_watch(TickitSigSub *sub, int signum)
+{
+  if(signum <= 0 || signum >= NSIG)
+    return false;
+
+  bool ret = true;
+  pthread_mutex_lock(&lock);
+
+  if(__atomic_load_n(&sub->watched[SIGWORD(signum)], __ATOMIC_SEQ_CST) & SIGBIT(signum))
+    goto out;
+
+  if(!refcount[signum]) {
+    /* The handler may land on any thread in the middle of any syscall. It only
+     * needs to wake the loop, so don't fail whatever was interrupted with
+     * EINTR. Process watches only care about exits, not stops.
+     */
+    struct sigaction act = {
+      .sa_handler = sighandler,
+      .sa_flags   = SA_RESTART,
+    };
+    if(signum == SIGCHLD)
+      act.sa_flags |= SA_NOCLDSTOP;
+    sigfillset(&act.sa_mask);
+
+    if(sigaction(signum, &act, &oldaction[signum]) == -1) {
+      ret = false;
+      goto out;
+    }
+  }
+  refcount[signum]++;
+
+  __atomic_fetch_or(&sub->watched[SIGWORD(signum)], SIGBIT(signum), __ATOMIC_SEQ_CST);
+
+out:
+  pthread_mutex_unlock(&lock);
+  return ret;
+}
+
+void tickit_sighub_unwatch(TickitSigSub *sub, int signum)
+{
+  if(signum <= 0 || signum >= NSIG)
+    return;
+
+  pthread_mutex_lock(&lock);
+
+  if(__atomic_fetch_and(&sub->watched[SIGWORD(signum)], ~SIGBIT(signum), __ATOMIC_SEQ_CST) & SIGBIT(signum))
+    release_signal(signum);
+
+  pthread_mutex_unlock(&lock);
+}
+
+void tickit_sighub_take_pending(TickitSigSub *sub, sigset_t *pending)
+{
+  uint64_t taken[SIGWORDS];
+  for(int word = 0; word < SIGWORDS; word++)
+    taken[word] = __atomic_exchange_n(&sub->pending[word], 0, __ATOMIC_SEQ_CST);
+
+  sigemptyset(pending);
+  for(int signum = 1; signum < NSIG; signum++)
+    if(taken[SIGWORD(signum)] & SIGBIT(signum))
+      sigaddset(pending, signum);
+}
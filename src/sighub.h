@@ -0,0 +1,18 @@
+#include "tickit.h"
+
+#include <signal.h>
+
+/* A process-wide signal handler shared by every toplevel instance in the
+ * process. Each subscriber registers an fd to be woken by writing a uint64_t
+ * to it, and collects the signals delivered since it last looked as a set.
+ */
+
+typedef struct TickitSigSub TickitSigSub;
+
+TickitSigSub *tickit_sighub_subscribe(int wakefd);
+void tickit_sighub_unsubscribe(TickitSigSub *sub);
+
+bool tickit_sighub_watch(TickitSigSub *sub, int signum);
+void tickit_sighub_unwatch(TickitSigSub *sub, int signum);
+
+void tickit_sighub_take_pending(TickitSigSub *sub, sigset_t *pending);
@@ -17,9 +17,11 @@
 #include <errno.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -42,6 +44,17 @@ static TickitTermDriverInfo *driver_infos[] = {
   NULL,
 };
 
+/* Formatted names of key events, interned by key code and modifiers so that
+ * each distinct key is only formatted once
+ */
+typedef struct {
+  int code;
+  int mod;
+  char *str;
+} KeyName;
+
+#define KEYNAMES_MAX 1024
+
 struct TickitTerm {
   int                   outfd;
   TickitTermOutputFunc *outfunc;
@@ -51,6 +64,33 @@ struct TickitTerm {
   TermKey              *termkey;
   struct timeval        input_timeout_at; /* absolute time */
 
+  KeyName *keynames;
+  int keynames_size, keynames_count;
+  /* Handlers may still hold the names while a key event is being run */
+  int keyevent_depth;
+  bool keynames_stale;
+
+  /* Text received between bracketed paste markers */
+  bool in_paste;
+  bool paste_cr; /* last pasted key was Enter, so a following LF is its CRLF */
+  char *pastebuffer;
+  size_t pastebuffer_len; /* size of pastebuffer */
+  size_t pastebuffer_cur; /* current fill level */
+
+  bool text_batch;
+
+  size_t input_buffersize; /* 0 for termkey's default */
+  char *inbuffer; /* read into when text_batch is enabled */
+  size_t inbuffer_len; /* not counting the spare byte to terminate runs in */
+  char *textbuffer; /* copies of pushed text runs, to terminate them */
+  size_t textbuffer_len;
+  bool textbuffer_busy;
+
+  /* A motion or wheel event held back in case the next one replaces it */
+  bool mouse_coalesce;
+  bool mouse_pending;
+  TickitMouseEventInfo pending_mouse;
+
   struct TickitTerminfoHook ti_hook;
 
   char *termtype;
@@ -87,6 +127,8 @@ struct TickitTerm {
 DEFINE_BINDINGS_FUNCS(term,TickitTerm,TickitTermEventFn)
 
 static void *get_tmpbuffer(TickitTerm *tt, size_t len);
+static void clear_keynames(TickitTerm *tt);
+static void invalidate_keynames(TickitTerm *tt);
 
 static const char *getstr_hook(const char *name, const char *value, void *_tt)
 {
@@ -142,6 +184,10 @@ static TermKey *get_termkey(TickitTerm *tt)
         unsetenv("TERM");
     }
 
+    /* If this fails termkey keeps its default-sized buffer, which still works */
+    if(tt->input_buffersize)
+      termkey_set_buffer_size(tt->termkey, tt->input_buffersize);
+
     termkey_hook_terminfo_getstr(tt->termkey, getstr_hook, tt);
     termkey_start(tt->termkey);
 
@@ -162,6 +208,7 @@ static TickitTermDriver *tickit_term_build_driver(struct TickitTermBuilder *buil
   TickitTermProbeArgs args = {
     .termtype = builder->termtype,
     .ti_hook  = builder->ti_hook,
+    .capcache = builder->capcache,
   };
 
   for(int i = 0; driver_infos[i]; i++) {
@@ -205,6 +252,30 @@ TickitTerm *tickit_term_build(const struct TickitTermBuilder *_builder)
   tt->termkey = NULL;
   tt->input_timeout_at.tv_sec = -1;
 
+  tt->keynames = NULL;
+  tt->keynames_size = 0;
+  tt->keynames_count = 0;
+  tt->keyevent_depth = 0;
+  tt->keynames_stale = false;
+
+  tt->in_paste = false;
+  tt->paste_cr = false;
+  tt->pastebuffer = NULL;
+  tt->pastebuffer_len = 0;
+  tt->pastebuffer_cur = 0;
+
+  tt->text_batch = false;
+
+  tt->input_buffersize = 0;
+  tt->inbuffer = NULL;
+  tt->inbuffer_len = 0;
+  tt->textbuffer = NULL;
+  tt->textbuffer_len = 0;
+  tt->textbuffer_busy = false;
+
+  tt->mouse_coalesce = false;
+  tt->mouse_pending = false;
+
   tt->outbuffer = NULL;
   tt->outbuffer_len = 0;
   tt->outbuffer_cur = 0;
@@ -277,6 +348,9 @@ TickitTerm *tickit_term_build(const struct TickitTermBuilder *_builder)
       break;
   }
 
+  /* Applied whenever termkey is created, as that is deferred until needed */
+  tt->input_buffersize = builder.input_buffersize;
+
   if(fd_in != -1)
     tickit_term_set_input_fd(tt, fd_in);
   if(fd_out != -1)
@@ -352,6 +426,13 @@ void tickit_term_destroy(TickitTerm *tt)
   if(tt->termkey)
     termkey_destroy(tt->termkey);
 
+  invalidate_keynames(tt);
+  free(tt->keynames);
+
+  free(tt->pastebuffer);
+  free(tt->inbuffer);
+  free(tt->textbuffer);
+
   if(tt->outbuffer)
     free(tt->outbuffer);
 
@@ -567,6 +648,8 @@ void tickit_term_set_input_fd(TickitTerm *tt, int fd)
   if(tt->termkey)
     termkey_destroy(tt->termkey);
 
+  clear_keynames(tt);
+
   tt->infd = fd;
   (void)get_termkey(tt);
 }
@@ -597,6 +680,9 @@ void tickit_term_set_utf8(TickitTerm *tt, bool utf8)
 
     termkey_set_flags(tt->termkey, flags);
   }
+
+  /* Non-ASCII keys will now be formatted differently */
+  invalidate_keynames(tt);
 }
 
 void tickit_term_await_started_msec(TickitTerm *tt, long msec)
@@ -655,8 +741,325 @@ void tickit_term_await_started_tv(TickitTerm *tt, const struct timeval *timeout)
   tt->state = STARTED;
 }
 
+/* Startup replies arrive as ordinary input, so we notice the driver has
+ * finished starting without anyone having to wait for it
+ */
+static void check_started(TickitTerm *tt)
+{
+  if(tt->state != STARTING)
+    return;
+
+  if(!tt->driver->vtable->started ||
+     (*tt->driver->vtable->started)(tt->driver))
+    tt->state = STARTED;
+}
+
+void tickit_termdrv_caps_changed(TickitTermDriver *ttd)
+{
+  TickitTerm *tt = ttd->tt;
+
+  tickit_term_getctl_int(tt, TICKIT_TERMCTL_COLORS, &tt->colors);
+
+  run_events(tt, TICKIT_TERM_ON_CAPSCHANGE, NULL);
+}
+
+static void clear_keynames(TickitTerm *tt)
+{
+  for(int i = 0; i < tt->keynames_size; i++) {
+    free(tt->keynames[i].str);
+    tt->keynames[i].str = NULL;
+  }
+
+  tt->keynames_count = 0;
+  tt->keynames_stale = false;
+}
+
+/* Key event handlers may change how keys are named; the names already handed
+ * out to the event being run must survive until it has finished
+ */
+static void invalidate_keynames(TickitTerm *tt)
+{
+  if(tt->keyevent_depth)
+    tt->keynames_stale = true;
+  else
+    clear_keynames(tt);
+}
+
+/* The named key ranges of TickitKeyCode follow the order of libtermkey's */
+static int keycode(const TermKeyKey *key)
+{
+  switch(key->type) {
+    case TERMKEY_TYPE_UNICODE:
+      return key->code.codepoint;
+    case TERMKEY_TYPE_FUNCTION:
+      return TICKIT_KEY_F(key->code.number);
+    case TERMKEY_TYPE_KEYSYM:
+      if(key->code.sym >= TERMKEY_SYM_BACKSPACE && key->code.sym <= TERMKEY_SYM_END)
+        return TICKIT_KEY_BACKSPACE + (key->code.sym - TERMKEY_SYM_BACKSPACE);
+      if(key->code.sym >= TERMKEY_SYM_KP0 && key->code.sym <= TERMKEY_SYM_KPEQUALS)
+        return TICKIT_KEY_KP0 + (key->code.sym - TERMKEY_SYM_KP0);
+      return TICKIT_KEY_OTHER;
+    default:
+      return TICKIT_KEY_NONE;
+  }
+}
+
+static int keyname_home(int code, int mod, int size)
+{
+  return ((unsigned int)code * 2654435761u ^ mod) & (size - 1);
+}
+
+static bool grow_keynames(TickitTerm *tt)
+{
+  KeyName *old = tt->keynames;
+  int oldsize = tt->keynames_size;
+
+  int newsize = oldsize ? oldsize * 2 : 64;
+  KeyName *keynames = calloc(newsize, sizeof(KeyName));
+  if(!keynames)
+    return false;
+
+  tt->keynames = keynames;
+  tt->keynames_size = newsize;
+
+  int mask = tt->keynames_size - 1;
+  for(int i = 0; i < oldsize; i++) {
+    if(!old[i].str)
+      continue;
+
+    int j = keyname_home(old[i].code, old[i].mod, tt->keynames_size);
+    while(tt->keynames[j].str)
+      j = (j + 1) & mask;
+    tt->keynames[j] = old[i];
+  }
+
+  free(old);
+  return true;
+}
+
+/* Returns the key's name, either interned or formatted into buffer */
+static const char *keyname(TickitTerm *tt, TermKey *tk, TermKeyKey *key, int code, char *buffer, size_t len)
+{
+  if(code == TICKIT_KEY_NONE || code == TICKIT_KEY_OTHER || tt->keynames_stale)
+    goto format;
+
+  if(tt->keynames_size) {
+    int mask = tt->keynames_size - 1;
+    for(int i = keyname_home(code, key->modifiers, tt->keynames_size);
+        tt->keynames[i].str;
+        i = (i + 1) & mask)
+      if(tt->keynames[i].code == code && tt->keynames[i].mod == key->modifiers)
+        return tt->keynames[i].str;
+  }
+
+  if(tt->keynames_count >= KEYNAMES_MAX)
+    goto format;
+
+  if((tt->keynames_count + 1) * 4 > tt->keynames_size * 3 && !grow_keynames(tt))
+    goto format;
+
+  termkey_strfkey(tk, buffer, len, key, TERMKEY_FORMAT_ALTISMETA);
+
+  char *str = strdup(buffer);
+  if(!str)
+    return buffer;
+
+  int mask = tt->keynames_size - 1;
+  int i = keyname_home(code, key->modifiers, tt->keynames_size);
+  while(tt->keynames[i].str)
+    i = (i + 1) & mask;
+
+  tt->keynames[i] = (KeyName){ .code = code, .mod = key->modifiers, .str = str };
+  tt->keynames_count++;
+
+  return str;
+
+format:
+  termkey_strfkey(tk, buffer, len, key, TERMKEY_FORMAT_ALTISMETA);
+  return buffer;
+}
+
+static void paste_append(TickitTerm *tt, const char *bytes, size_t len)
+{
+  /* Leave room for the terminating NUL */
+  if(tt->pastebuffer_cur + len + 1 > tt->pastebuffer_len) {
+    size_t newlen = tt->pastebuffer_len ? tt->pastebuffer_len : 256;
+    while(tt->pastebuffer_cur + len + 1 > newlen)
+      newlen *= 2;
+
+    char *newbuffer = realloc(tt->pastebuffer, newlen);
+    if(!newbuffer)
+      return;
+
+    tt->pastebuffer = newbuffer;
+    tt->pastebuffer_len = newlen;
+  }
+
+  memcpy(tt->pastebuffer + tt->pastebuffer_cur, bytes, len);
+  tt->pastebuffer_cur += len;
+}
+
+/* termkey has already parsed pasted bytes into keys; turn them back into
+ * the text that would have produced them
+ */
+static void paste_key(TickitTerm *tt, TermKeyKey *key)
+{
+  bool after_cr = tt->paste_cr;
+  tt->paste_cr = false;
+
+  if(key->type == TERMKEY_TYPE_UNICODE) {
+    if(key->modifiers & TERMKEY_KEYMOD_ALT)
+      paste_append(tt, "\e", 1);
+
+    if(key->modifiers & TERMKEY_KEYMOD_CTRL) {
+      char c = key->code.codepoint & 0x1f;
+      /* The LF of a CRLF was already appended as part of the Enter; a NUL
+       * would just truncate the pasted string
+       */
+      if((c == '\n' && after_cr) || c == 0)
+        return;
+      paste_append(tt, &c, 1);
+    }
+    else
+      paste_append(tt, key->utf8, strlen(key->utf8));
+  }
+  else if(key->type == TERMKEY_TYPE_KEYSYM)
+    switch(key->code.sym) {
+      case TERMKEY_SYM_ENTER:
+        paste_append(tt, "\n", 1);
+        tt->paste_cr = true;
+        break;
+      case TERMKEY_SYM_TAB:    paste_append(tt, "\t", 1); break;
+      case TERMKEY_SYM_SPACE:  paste_append(tt, " ",  1); break;
+      case TERMKEY_SYM_ESCAPE: paste_append(tt, "\e", 1); break;
+      /* TERMKEY_CANON_DELBS turns DEL into Backspace, and ^H arrives as C-h */
+      case TERMKEY_SYM_BACKSPACE:
+      case TERMKEY_SYM_DEL:    paste_append(tt, "\x7f", 1); break;
+      default:
+        break;
+    }
+}
+
+static void got_paste(TickitTerm *tt)
+{
+  paste_append(tt, "", 0);
+  if(!tt->pastebuffer)
+    return;
+
+  tt->pastebuffer[tt->pastebuffer_cur] = 0;
+
+  TickitKeyEventInfo info = {
+    .type = TICKIT_KEYEV_PASTE,
+    .str  = tt->pastebuffer,
+    .mod  = 0,
+  };
+
+  run_events_whilefalse(tt, TICKIT_TERM_ON_KEY, &info);
+
+  tt->pastebuffer_cur = 0;
+
+  /* Don't hold on to the memory of one huge paste */
+  if(tt->pastebuffer_len > 65536) {
+    free(tt->pastebuffer);
+    tt->pastebuffer = NULL;
+    tt->pastebuffer_len = 0;
+  }
+}
+
+static void got_mouse(TickitTerm *tt, TickitMouseEventInfo *info)
+{
+  if(info->type == TICKIT_MOUSEEV_PRESS || info->type == TICKIT_MOUSEEV_DRAG) {
+    tt->mouse_buttons_held |= (1 << info->button);
+  }
+  else if(info->type == TICKIT_MOUSEEV_RELEASE && info->button) {
+    tt->mouse_buttons_held &= ~(1 << info->button);
+  }
+  else if(info->type == TICKIT_MOUSEEV_RELEASE) {
+    /* X10 cannot report which button was released. Just report that they 
+     * all were */
+    for(info->button = 1; tt->mouse_buttons_held; info->button++)
+      if(tt->mouse_buttons_held & (1 << info->button)) {
+        run_events_whilefalse(tt, TICKIT_TERM_ON_MOUSE, info);
+        tt->mouse_buttons_held &= ~(1 << info->button);
+      }
+    return; // Buttons have been handled
+  }
+
+  run_events_whilefalse(tt, TICKIT_TERM_ON_MOUSE, info);
+}
+
+static void flush_mouse(TickitTerm *tt)
+{
+  if(!tt->mouse_pending)
+    return;
+
+  tt->mouse_pending = false;
+
+  TickitMouseEventInfo info = tt->pending_mouse;
+  got_mouse(tt, &info);
+}
+
+/* With TICKIT_TERMCTL_MOUSE_COALESCE, consecutive drag or motion events for
+ * the same buttons collapse into the last of them, and consecutive wheel
+ * steps in the same direction into a single event with a count
+ */
+static void coalesce_mouse(TickitTerm *tt, TickitMouseEventInfo *info)
+{
+  TickitMouseEventInfo *pending = &tt->pending_mouse;
+
+  if(tt->mouse_pending &&
+     info->type   == pending->type &&
+     info->button == pending->button &&
+     info->mod    == pending->mod) {
+    int count = pending->count;
+    *pending = *info;
+    if(info->type == TICKIT_MOUSEEV_WHEEL)
+      pending->count += count;
+    return;
+  }
+
+  flush_mouse(tt);
+
+  if(info->type == TICKIT_MOUSEEV_DRAG || info->type == TICKIT_MOUSEEV_WHEEL) {
+    *pending = *info;
+    tt->mouse_pending = true;
+    return;
+  }
+
+  got_mouse(tt, info);
+}
+
 static void got_key(TickitTerm *tt, TermKey *tk, TermKeyKey *key)
 {
+  if(key->type != TERMKEY_TYPE_MOUSE)
+    flush_mouse(tt);
+
+  if(key->type == TERMKEY_TYPE_UNKNOWN_CSI) {
+    long args[1];
+    size_t nargs = 1;
+    unsigned long cmd;
+    if(termkey_interpret_csi(tk, key, args, &nargs, &cmd) != TERMKEY_RES_KEY ||
+       cmd != '~' || nargs != 1)
+      return;
+
+    if(args[0] == 200) { // Bracketed paste start
+      tt->in_paste = true;
+      tt->paste_cr = false;
+      tt->pastebuffer_cur = 0;
+    }
+    else if(args[0] == 201 && tt->in_paste) { // Bracketed paste end
+      tt->in_paste = false;
+      got_paste(tt);
+    }
+    return;
+  }
+
+  if(tt->in_paste &&
+     (key->type == TERMKEY_TYPE_UNICODE || key->type == TERMKEY_TYPE_KEYSYM)) {
+    paste_key(tt, key);
+    return;
+  }
+
   if(key->type == TERMKEY_TYPE_MOUSE) {
     TermKeyMouseEvent ev;
     TickitMouseEventInfo info;
@@ -677,25 +1080,12 @@ static void got_key(TickitTerm *tt, TermKey *tk, TermKeyKey *key)
     }
 
     info.mod = key->modifiers;
+    info.count = 1;
 
-    if(info.type == TICKIT_MOUSEEV_PRESS || info.type == TICKIT_MOUSEEV_DRAG) {
-      tt->mouse_buttons_held |= (1 << info.button);
-    }
-    else if(info.type == TICKIT_MOUSEEV_RELEASE && info.button) {
-      tt->mouse_buttons_held &= ~(1 << info.button);
-    }
-    else if(info.type == TICKIT_MOUSEEV_RELEASE) {
-      /* X10 cannot report which button was released. Just report that they 
-       * all were */
-      for(info.button = 1; tt->mouse_buttons_held; info.button++)
-        if(tt->mouse_buttons_held & (1 << info.button)) {
-          run_events_whilefalse(tt, TICKIT_TERM_ON_MOUSE, &info);
-          tt->mouse_buttons_held &= ~(1 << info.button);
-        }
-      return; // Buttons have been handled
-    }
-
-    run_events_whilefalse(tt, TICKIT_TERM_ON_MOUSE, &info);
+    if(tt->mouse_coalesce)
+      coalesce_mouse(tt, &info);
+    else
+      got_mouse(tt, &info);
   }
   else if(key->type == TERMKEY_TYPE_UNICODE && !key->modifiers) {
     /* Unmodified unicode */
@@ -703,6 +1093,7 @@ static void got_key(TickitTerm *tt, TermKey *tk, TermKeyKey *key)
       .type = TICKIT_KEYEV_TEXT,
       .str  = key->utf8,
       .mod  = key->modifiers,
+      .code = key->code.codepoint,
     };
 
     run_events_whilefalse(tt, TICKIT_TERM_ON_KEY, &info);
@@ -711,15 +1102,19 @@ static void got_key(TickitTerm *tt, TermKey *tk, TermKeyKey *key)
           key->type == TERMKEY_TYPE_FUNCTION ||
           key->type == TERMKEY_TYPE_KEYSYM) {
     char buffer[64]; // TODO: should be long enough
-    termkey_strfkey(tk, buffer, sizeof buffer, key, TERMKEY_FORMAT_ALTISMETA);
+    int code = keycode(key);
 
     TickitKeyEventInfo info = {
       .type = TICKIT_KEYEV_KEY,
-      .str  = buffer,
+      .str  = keyname(tt, tk, key, code, buffer, sizeof buffer),
       .mod  = key->modifiers,
+      .code = code,
     };
 
+    tt->keyevent_depth++;
     run_events_whilefalse(tt, TICKIT_TERM_ON_KEY, &info);
+    if(!--tt->keyevent_depth && tt->keynames_stale)
+      clear_keynames(tt);
   }
   else if(key->type == TERMKEY_TYPE_MODEREPORT) {
     if(tt->driver->vtable->on_modereport) {
@@ -727,6 +1122,7 @@ static void got_key(TickitTerm *tt, TermKey *tk, TermKeyKey *key)
       termkey_interpret_modereport(tk, key, &initial, &mode, &value);
 
       (tt->driver->vtable->on_modereport)(tt->driver, initial, mode, value);
+      check_started(tt);
     }
   }
   else if(key->type == TERMKEY_TYPE_DCS) {
@@ -737,6 +1133,7 @@ static void got_key(TickitTerm *tt, TermKey *tk, TermKeyKey *key)
     if(strneq(dcs, "1$r", 3)) { // Successful DECRQSS
       if(tt->driver->vtable->on_decrqss)
         (tt->driver->vtable->on_decrqss)(tt->driver, dcs + 3, strlen(dcs + 3));
+      check_started(tt);
     }
   }
 }
@@ -751,6 +1148,203 @@ void tickit_term_emit_mouse(TickitTerm *tt, TickitMouseEventInfo *info)
   run_events_whilefalse(tt, TICKIT_TERM_ON_MOUSE, info);
 }
 
+#define ONES  (~(uint64_t)0 / 255)
+#define HIGHS (ONES * 0x80)
+
+/* Returns the length of the initial run of bytes that termkey would decode
+ * as plain unmodified text; i.e. printable ASCII, and in UTF-8 mode any
+ * complete, well-formed sequence for a printable codepoint
+ */
+static size_t scan_text(const char *bytes, size_t len, bool utf8)
+{
+  const unsigned char *s = (const unsigned char *)bytes;
+  size_t i = 0;
+
+  while(i < len) {
+    /* Skip over printable ASCII eight bytes at a time. A word is entirely
+     * within 0x20 to 0x7e if no byte is below 0x20 and no byte, after adding
+     * 1, has its top bit set
+     */
+    while(len - i >= 8) {
+      uint64_t w;
+      memcpy(&w, s + i, 8);
+      if(((w - ONES * 0x20) & ~w & HIGHS) || (((w + ONES) | w) & HIGHS))
+        break;
+      i += 8;
+    }
+    if(i == len)
+      break;
+
+    unsigned char c = s[i];
+    if(c >= 0x20 && c < 0x7f) {
+      i++;
+      continue;
+    }
+    if(!utf8 || c < 0xc2 || c > 0xf4)
+      break;
+
+    size_t seqlen = c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+    if(len - i < seqlen)
+      break;
+
+    uint32_t cp = c & (0x7f >> seqlen);
+    size_t j;
+    for(j = 1; j < seqlen; j++) {
+      if((s[i+j] & 0xc0) != 0x80)
+        break;
+      cp = (cp << 6) | (s[i+j] & 0x3f);
+    }
+    if(j < seqlen)
+      break;
+
+    /* Reject overlong forms, surrogates, out-of-range and C1 controls;
+     * termkey would not decode those as text
+     */
+    if(cp < 0xa0 || (seqlen == 3 && cp < 0x800) || (seqlen == 4 && cp < 0x10000) ||
+       (cp >= 0xd800 && cp < 0xe000) || cp > 0x10ffff)
+      break;
+
+    i += seqlen;
+  }
+
+  return i;
+}
+
+/* The event needs the run NUL-terminated. A run in inbuffer is terminated in
+ * place, as there is always a byte after it to borrow. Other runs are copied
+ * into textbuffer, or a fresh allocation if a handler pushes more text while
+ * textbuffer is still in use.
+ */
+static void got_text(TickitTerm *tt, const char *bytes, size_t len, bool inplace)
+{
+  flush_mouse(tt);
+
+  char *str;
+  char saved = 0;
+  bool borrowed = false;
+
+  if(inplace) {
+    str = (char *)bytes;
+    saved = str[len];
+  }
+  else if(!tt->textbuffer_busy) {
+    if(tt->textbuffer_len < len + 1) {
+      char *textbuffer = realloc(tt->textbuffer, len + 1);
+      if(!textbuffer)
+        return;
+      tt->textbuffer = textbuffer;
+      tt->textbuffer_len = len + 1;
+    }
+    str = tt->textbuffer;
+    tt->textbuffer_busy = borrowed = true;
+  }
+  else if(!(str = malloc(len + 1)))
+    return;
+
+  if(!inplace)
+    memcpy(str, bytes, len);
+  str[len] = 0;
+
+  TickitKeyEventInfo info = {
+    .type = TICKIT_KEYEV_TEXT,
+    .str  = str,
+    .mod  = 0,
+  };
+
+  run_events_whilefalse(tt, TICKIT_TERM_ON_KEY, &info);
+
+  if(inplace)
+    str[len] = saved;
+  else if(borrowed)
+    tt->textbuffer_busy = false;
+  else
+    free(str);
+}
+
+static void drain_keys(TickitTerm *tt, TermKey *tk)
+{
+  TermKeyKey key;
+  while(termkey_getkey(tk, &key) == TERMKEY_RES_KEY)
+    got_key(tt, tk, &key);
+}
+
+/* With TICKIT_TERMCTL_TEXT_BATCH, runs of plain text that begin at a key
+ * boundary are delivered as a single event; everything else still goes
+ * through termkey. If inplace is set, bytes[len] may be overwritten while an
+ * event runs, so that runs needn't be copied.
+ */
+static void push_bytes(TickitTerm *tt, TermKey *tk, const char *bytes, size_t len, bool inplace)
+{
+  size_t bufsize = termkey_get_buffer_size(tk);
+
+  while(len) {
+    if(!tt->text_batch || tt->in_paste) {
+      size_t pushed = termkey_push_bytes(tk, bytes, len);
+      bytes += pushed;
+      len   -= pushed;
+
+      /* termkey only takes as much as fits in its buffer; hand out the keys
+       * it holds to make room for the rest
+       */
+      if(len) {
+        drain_keys(tt, tk);
+        if(!termkey_get_buffer_remaining(tk))
+          break;
+      }
+      continue;
+    }
+
+    if(termkey_get_buffer_remaining(tk) == bufsize) {
+      size_t run = scan_text(bytes, len, tt->is_utf8 == TICKIT_YES);
+      if(run > 1) {
+        got_text(tt, bytes, run, inplace);
+        bytes += run;
+        len   -= run;
+        continue;
+      }
+    }
+
+    /* Feed termkey a byte at a time so we notice as soon as it has consumed
+     * a whole key, and another run of text might begin
+     */
+    termkey_push_bytes(tk, bytes, 1);
+    drain_keys(tt, tk);
+    bytes++;
+    len--;
+  }
+}
+
+static void read_input(TickitTerm *tt, TermKey *tk)
+{
+  if(!tt->text_batch) {
+    termkey_advisereadable(tk);
+    return;
+  }
+
+  /* Read as much at once as termkey itself would */
+  size_t size = termkey_get_buffer_size(tk);
+  if(tt->inbuffer_len < size) {
+    char *inbuffer = malloc(size + 1);
+    if(!inbuffer) {
+      /* Still read the input, just without batching it */
+      termkey_advisereadable(tk);
+      return;
+    }
+
+    free(tt->inbuffer);
+    tt->inbuffer = inbuffer;
+    tt->inbuffer_len = size;
+  }
+
+  ssize_t len = read(termkey_get_fd(tk), tt->inbuffer, size);
+
+  if(len > 0)
+    push_bytes(tt, tk, tt->inbuffer, len, true);
+  else if(len == 0)
+    /* Let termkey observe the EOF itself */
+    termkey_advisereadable(tk);
+}
+
 static void get_keys(TickitTerm *tt, TermKey *tk)
 {
   TermKeyResult res;
@@ -759,6 +1353,9 @@ static void get_keys(TickitTerm *tt, TermKey *tk)
     got_key(tt, tk, &key);
   }
 
+  /* Nothing more is buffered that could replace it */
+  flush_mouse(tt);
+
   if(res == TERMKEY_RES_AGAIN) {
     struct timeval tv;
     gettimeofday(&tv, NULL);
@@ -783,7 +1380,7 @@ void tickit_term_input_push_bytes(TickitTerm *tt, const char *bytes, size_t len)
   check_resize(tt);
 
   TermKey *tk = get_termkey(tt);
-  termkey_push_bytes(tk, bytes, len);
+  push_bytes(tt, tk, bytes, len, false);
 
   get_keys(tt, tk);
 }
@@ -793,11 +1390,20 @@ void tickit_term_input_readable(TickitTerm *tt)
   check_resize(tt);
 
   TermKey *tk = get_termkey(tt);
-  termkey_advisereadable(tk);
+  read_input(tt, tk);
 
   get_keys(tt, tk);
 }
 
+bool tickit_term_input_pending(TickitTerm *tt)
+{
+  if(tt->infd == -1)
+    return false;
+
+  struct pollfd pfd = { .fd = tt->infd, .events = POLLIN };
+  return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
 static int get_timeout(TickitTerm *tt)
 {
   if(tt->input_timeout_at.tv_sec == -1)
@@ -832,6 +1438,8 @@ static void timedout(TickitTerm *tt)
     got_key(tt, tk, &key);
   }
 
+  flush_mouse(tt);
+
   tt->input_timeout_at.tv_sec = -1;
 }
 
@@ -877,7 +1485,7 @@ void tickit_term_input_wait_msec(TickitTerm *tt, long msec)
   if(ret == 0)
     timedout(tt);
   else if(ret > 0)
-    termkey_advisereadable(tk);
+    read_input(tt, tk);
 
   check_resize(tt);
 
@@ -1098,11 +1706,40 @@ void tickit_term_erasech(TickitTerm *tt, int count, TickitMaybeBool moveend)
 
 bool tickit_term_getctl_int(TickitTerm *tt, TickitTermCtl ctl, int *value)
 {
+  /* Handled by the terminal itself, not the driver */
+  switch(ctl) {
+    case TICKIT_TERMCTL_TEXT_BATCH:
+      *value = tt->text_batch;
+      return true;
+
+    case TICKIT_TERMCTL_MOUSE_COALESCE:
+      *value = tt->mouse_coalesce;
+      return true;
+
+    default:
+      break;
+  }
+
   return (*tt->driver->vtable->getctl_int)(tt->driver, ctl, value);
 }
 
 bool tickit_term_setctl_int(TickitTerm *tt, TickitTermCtl ctl, int value)
 {
+  switch(ctl) {
+    case TICKIT_TERMCTL_TEXT_BATCH:
+      tt->text_batch = !!value;
+      return true;
+
+    case TICKIT_TERMCTL_MOUSE_COALESCE:
+      tt->mouse_coalesce = !!value;
+      if(!value)
+        flush_mouse(tt);
+      return true;
+
+    default:
+      break;
+  }
+
   return (*tt->driver->vtable->setctl_int)(tt->driver, ctl, value);
 }
 
@@ -1149,6 +1786,9 @@ const char *tickit_termctl_name(TickitTermCtl ctl)
     case TICKIT_TERMCTL_ICONTITLE_TEXT: return "icontitle_text";
     case TICKIT_TERMCTL_KEYPAD_APP:     return "keypad_app";
     case TICKIT_TERMCTL_COLORS:         return "colors";
+    case TICKIT_TERMCTL_PASTE_BRACKETED: return "paste_bracketed";
+    case TICKIT_TERMCTL_TEXT_BATCH:     return "text_batch";
+    case TICKIT_TERMCTL_MOUSE_COALESCE: return "mouse_coalesce";
 
     case TICKIT_N_TERMCTLS: ;
   }
@@ -1201,6 +1841,9 @@ TickitType tickit_termctl_type(TickitTermCtl ctl)
     case TICKIT_TERMCTL_CURSORVIS:
     case TICKIT_TERMCTL_CURSORBLINK:
     case TICKIT_TERMCTL_KEYPAD_APP:
+    case TICKIT_TERMCTL_PASTE_BRACKETED:
+    case TICKIT_TERMCTL_TEXT_BATCH:
+    case TICKIT_TERMCTL_MOUSE_COALESCE:
       return TICKIT_TYPE_BOOL;
 
     case TICKIT_TERMCTL_COLORS:
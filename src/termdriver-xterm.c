@@ -1,5 +1,7 @@
 #include "termdriver.h"
 
+#include "capcache.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,6 +25,7 @@ struct XTermDriver {
     unsigned int cursorshape:2;
     unsigned int mouse:2;
     unsigned int keypad:1;
+    unsigned int paste:1;
   } mode;
 
   struct {
@@ -38,8 +41,53 @@ struct XTermDriver {
     unsigned int cursorshape:2;
     unsigned int slrm:1;
   } initialised;
+
+  /* Set by the application before the terminal reported them, so a late
+   * reply must not override them
+   */
+  struct {
+    unsigned int cursorvis:1;
+    unsigned int cursorblink:1;
+    unsigned int cursorshape:1;
+    unsigned int rgb8:1;
+  } set;
+
+  /* Replies seen so far; the SGR query is answered last, so by then any
+   * capability not confirmed is known to be absent
+   */
+  struct {
+    unsigned int cursorshape:1;
+    unsigned int slrm:1;
+  } probed;
+
+  char *capcache_key;
+  unsigned int capcache_caps;
 };
 
+/* Bits of the capability cache entry */
+enum {
+  CAPCACHE_CURSORSHAPE   = 1<<0,
+  CAPCACHE_SLRM          = 1<<1,
+  CAPCACHE_CSI_SUB_COLON = 1<<2,
+  CAPCACHE_RGB8          = 1<<3,
+};
+
+static unsigned int pack_caps(struct XTermDriver *xd)
+{
+  return (xd->cap.cursorshape   ? CAPCACHE_CURSORSHAPE   : 0) |
+         (xd->cap.slrm          ? CAPCACHE_SLRM          : 0) |
+         (xd->cap.csi_sub_colon ? CAPCACHE_CSI_SUB_COLON : 0) |
+         (xd->cap.rgb8          ? CAPCACHE_RGB8          : 0);
+}
+
+static void unpack_caps(struct XTermDriver *xd, unsigned int caps)
+{
+  xd->cap.cursorshape   = !!(caps & CAPCACHE_CURSORSHAPE);
+  xd->cap.slrm          = !!(caps & CAPCACHE_SLRM);
+  xd->cap.csi_sub_colon = !!(caps & CAPCACHE_CSI_SUB_COLON);
+  xd->cap.rgb8          = !!(caps & CAPCACHE_RGB8);
+}
+
 enum {
   TERMCTL_CAP_CURSORSHAPE = TICKIT_TERMCTL_PRIVATE_XTERM + 1,
   TERMCTL_CAP_SLRM,
@@ -389,6 +437,10 @@ static bool getctl_int(TickitTermDriver *ttd, TickitTermCtl ctl, int *value)
       *value = xd->mode.keypad;
       return true;
 
+    case TICKIT_TERMCTL_PASTE_BRACKETED:
+      *value = xd->mode.paste;
+      return true;
+
     case TICKIT_TERMCTL_COLORS:
       *value = xd->cap.rgb8 ? (1<<24) : 256;
       return true;
@@ -420,6 +472,7 @@ static bool setctl_int(TickitTermDriver *ttd, TickitTermCtl ctl, int value)
       // Allow forcing this on/off because maybe the user (or at least the
       // calling program) has a better idea than our probing via DECRQSS
       xd->cap.rgb8 = !!value;
+      xd->set.rgb8 = 1;
       return true;
   }
 
@@ -438,6 +491,7 @@ static bool setctl_int(TickitTermDriver *ttd, TickitTermCtl ctl, int value)
 
       tickit_termdrv_write_str(ttd, value ? "\e[?25h" : "\e[?25l", 0);
       xd->mode.cursorvis = !!value;
+      xd->set.cursorvis = 1;
       return true;
 
     case TICKIT_TERMCTL_CURSORBLINK:
@@ -446,6 +500,7 @@ static bool setctl_int(TickitTermDriver *ttd, TickitTermCtl ctl, int value)
 
       tickit_termdrv_write_str(ttd, value ? "\e[?12h" : "\e[?12l", 0);
       xd->mode.cursorblink = !!value;
+      xd->set.cursorblink = 1;
       return true;
 
     case TICKIT_TERMCTL_MOUSE:
@@ -470,6 +525,7 @@ static bool setctl_int(TickitTermDriver *ttd, TickitTermCtl ctl, int value)
       if(xd->cap.cursorshape)
         tickit_termdrv_write_strf(ttd, "\e[%d q", value * 2 + (xd->mode.cursorblink ? -1 : 0));
       xd->mode.cursorshape = value;
+      xd->set.cursorshape = 1;
       return true;
 
     case TICKIT_TERMCTL_KEYPAD_APP:
@@ -479,6 +535,14 @@ static bool setctl_int(TickitTermDriver *ttd, TickitTermCtl ctl, int value)
       tickit_termdrv_write_strf(ttd, value ? "\e=" : "\e>");
       return true;
 
+    case TICKIT_TERMCTL_PASTE_BRACKETED:
+      if(!xd->mode.paste == !value)
+        return true;
+
+      tickit_termdrv_write_str(ttd, value ? "\e[?2004h" : "\e[?2004l", 0);
+      xd->mode.paste = !!value;
+      return true;
+
     default:
       return false;
   }
@@ -545,18 +609,18 @@ static int on_modereport(TickitTermDriver *ttd, int initial, int mode, int value
   if(initial == '?') // DEC mode
     switch(mode) {
       case 12: // Cursor blink
-        if(value == 1)
+        if(value == 1 && !xd->set.cursorblink)
           xd->mode.cursorblink = 1;
         xd->initialised.cursorblink = 1;
         break;
       case 25: // DECTCEM == Cursor visibility
-        if(value == 1)
+        if(value == 1 && !xd->set.cursorvis)
           xd->mode.cursorvis = 1;
         xd->initialised.cursorvis = 1;
         break;
       case 69: // DECVSSM
-        if(value == 1 || value == 2)
-          xd->cap.slrm = 1;
+        xd->cap.slrm = (value == 1 || value == 2);
+        xd->probed.slrm = 1;
         xd->initialised.slrm = 1;
         break;
     }
@@ -573,26 +637,54 @@ static int on_decrqss(TickitTermDriver *ttd, const char *args, size_t arglen)
     if(sscanf(args, "%d", &value)) {
       // value==1 or 2 => shape == 1, 3 or 4 => 2, etc..
       int shape = (value+1) / 2;
-      xd->mode.cursorshape = shape;
+      if(!xd->set.cursorshape)
+        xd->mode.cursorshape = shape;
+      else if(!xd->cap.cursorshape && xd->mode.cursorshape != shape) {
+        // Apply the shape that was requested before we knew we could
+        tickit_termdrv_write_strf(ttd, "\e[%d q", xd->mode.cursorshape * 2 + (xd->mode.cursorblink ? -1 : 0));
+        tickit_term_flush(ttd->tt);
+      }
       xd->cap.cursorshape = 1;
+      xd->probed.cursorshape = 1;
     }
     xd->initialised.cursorshape = 1;
   }
   else if(strneq(args + arglen - 1, "m", 1)) { // SGR
+    bool colon = false, rgb8 = false;
+
     // skip the initial number, find the first separator
     while(arglen && args[0] >= '0' && args[0] <= '9')
       args++, arglen--;
-    if(!arglen)
-      return 1;
+    if(arglen) {
+      colon = (args[0] == ':');
+      args++, arglen--;
 
-    if(args[0] == ':')
-      xd->cap.csi_sub_colon = 1;
-    args++, arglen--;
+      // If the palette index is 2 then the terminal understands rgb8
+      int value;
+      rgb8 = (sscanf(args, "%d", &value) == 1 && value == 2);
+    }
 
-    // If the palette index is 2 then the terminal understands rgb8
-    int value;
-    if(sscanf(args, "%d", &value) && value == 2)
-      xd->cap.rgb8 = 1;
+    /* This is the answer to our final query, so it is authoritative even over
+     * capabilities loaded from the cache
+     */
+    xd->cap.csi_sub_colon = colon;
+    if(!xd->probed.cursorshape)
+      xd->cap.cursorshape = 0;
+    if(!xd->probed.slrm)
+      xd->cap.slrm = 0;
+
+    if(!xd->set.rgb8 && xd->cap.rgb8 != rgb8) {
+      xd->cap.rgb8 = rgb8;
+      // Anything already drawn in approximated colours can now be redrawn
+      tickit_termdrv_caps_changed(ttd);
+    }
+
+    // Cache what the terminal said, not what the application forced
+    unsigned int caps = (pack_caps(xd) & ~CAPCACHE_RGB8) | (rgb8 ? CAPCACHE_RGB8 : 0);
+    if(xd->capcache_key && caps != xd->capcache_caps) {
+      tickit_capcache_store(xd->capcache_key, caps);
+      xd->capcache_caps = caps;
+    }
   }
 
   return 1;
@@ -610,6 +702,8 @@ static void teardown(TickitTermDriver *ttd)
     tickit_termdrv_write_str(ttd, "\e[?1049l", 0);
   if(xd->mode.keypad)
     tickit_termdrv_write_strf(ttd, "\e>");
+  if(xd->mode.paste)
+    tickit_termdrv_write_str(ttd, "\e[?2004l", 0);
 
   // Reset pen
   tickit_termdrv_write_str(ttd, "\e[m", 3);
@@ -627,12 +721,15 @@ static void resume(TickitTermDriver *ttd)
     tickit_termdrv_write_str(ttd, "\e[?25l", 0);
   if(xd->mode.mouse)
     tickit_termdrv_write_strf(ttd, "\e[?%dh\e[?1006h", mode_for_mouse(xd->mode.mouse));
+  if(xd->mode.paste)
+    tickit_termdrv_write_str(ttd, "\e[?2004h", 0);
 }
 
 static void destroy(TickitTermDriver *ttd)
 {
   struct XTermDriver *xd = (struct XTermDriver *)ttd;
 
+  free(xd->capcache_key);
   free(xd);
 }
 
@@ -683,6 +780,18 @@ static TickitTermDriver *new(const TickitTermProbeArgs *args)
   memset(&xd->cap, 0, sizeof xd->cap);
 
   memset(&xd->initialised, 0, sizeof xd->initialised);
+  memset(&xd->set, 0, sizeof xd->set);
+  memset(&xd->probed, 0, sizeof xd->probed);
+
+  xd->capcache_key = NULL;
+  if(args->capcache)
+    xd->capcache_key = tickit_capcache_key(xd->driver.name, termtype);
+
+  // Start with whatever this terminal was found to support last time
+  if(xd->capcache_key && tickit_capcache_load(xd->capcache_key, &xd->capcache_caps))
+    unpack_caps(xd, xd->capcache_caps);
+  else
+    xd->capcache_caps = ~0U; /* ensure the first probe result is stored */
 
   return (TickitTermDriver*)xd;
 }
@@ -15,6 +15,7 @@ enum {
 typedef struct {
   const char *termtype;
   const struct TickitTerminfoHook *ti_hook;
+  bool capcache;
 } TickitTermProbeArgs;
 
 typedef struct {
@@ -1,18 +1,39 @@
 #include "tickit.h"
 #include "tickit-evloop.h"
 
+#include "sighub.h"
+
+#ifdef __linux__
+#  define HAVE_EVENTFD 1
+#endif
+
+#ifndef HAVE_EVENTFD
+#  define HAVE_EVENTFD 0
+#endif
+
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <signal.h>
 #include <string.h>
 #include <sys/time.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
-/* POSIX doesn't actually define an NSIG macro, but if it did, almost every
- * known platform would set it to 32
- */
-#ifndef NSIG
-#  define NSIG 32
+#if HAVE_EVENTFD
+#  include <sys/eventfd.h>
+#endif
+
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+
+/* pidfd_open() has no glibc wrapper until 2.36, so we invoke it directly */
+#ifdef SYS_pidfd_open
+#  define HAVE_PIDFD 1
+#else
+#  define HAVE_PIDFD 0
 #endif
 
 #define streq(a,b) (!strcmp(a,b))
@@ -32,6 +53,7 @@ struct TickitWatch {
     WATCH_LATER,
     WATCH_SIGNAL,
     WATCH_PROCESS,
+    WATCH_WORK,
   } type;
 
   TickitBindFlags flags;
@@ -60,10 +82,56 @@ struct TickitWatch {
     struct {
       pid_t pid;
       int wstatus; /* in case of pre-exited process */
+      int pidfd;
+      void *pidfdwatch;
     } process;
+
+    struct {
+      TickitWorkFn *fn;
+      TickitWatch *qnext; /* guarded by the pool lock */
+      bool started;       /* guarded by the pool lock */
+      bool cancelled;     /* only touched on the loop thread */
+    } work;
   };
 };
 
+/* Watches are carved out of slabs and recycled through a free list, so the
+ * steady churn of timers and laters needs no heap operations
+ */
+#define WATCHES_PER_SLAB 32
+
+typedef struct WatchSlab WatchSlab;
+struct WatchSlab {
+  WatchSlab *next;
+  TickitWatch watches[WATCHES_PER_SLAB];
+};
+
+/* Log-linear histogram buckets; each power of two is split into 4 linear
+ * sub-buckets, so any value is reported to within 25%
+ */
+#define LOOPSTAT_SUBBITS  2
+#define LOOPSTAT_NBUCKETS 128
+
+struct LoopStat {
+  unsigned long counts[LOOPSTAT_NBUCKETS];
+  unsigned long count, total_usec, max_usec;
+  TickitCallbackFn *slowest;
+};
+
+struct LoopStats {
+  struct LoopStat stats[TICKIT_N_LOOPSTATS];
+  uint64_t poll_begin, poll_end;
+};
+
+typedef struct TickitPost TickitPost;
+struct TickitPost {
+  TickitPost *next;
+
+  TickitBindFlags flags;
+  TickitCallbackFn *fn;
+  void *user;
+};
+
 extern TickitEventHooks tickit_evloop_default;
 
 struct Tickit {
@@ -72,24 +140,117 @@ struct Tickit {
   TickitTerm   *term;
   TickitWindow *rootwin;
 
-  TickitWatch *iowatches, *timers, *laters, *signals, *processes;
+  TickitWatch *iowatches, *timers, *laters, *signals, *processes, *works;
+
+  WatchSlab   *watchslabs;
+  TickitWatch *freewatches;
 
   const TickitEventHooks *evhooks;
   void                   *evdata;
 
   struct {
-    int pipefds[2];
-    void *pipewatch;
-    sigset_t watched;
-    sigset_t pending;
+    int fds[2]; /* see open_wakeup() */
+    TickitSigSub *sub;
+    void *watch;
   } signal;
 
   void *sigchldwatch;
 
+  struct {
+    TickitPost *head; /* newest first; pushed atomically by any thread */
+    int fds[2];       /* see open_wakeup() */
+    void *watch;
+  } post;
+
+  struct {
+    int nthreads;       /* 0 for one per online CPU */
+    pthread_t *threads; /* NULL until the first work is queued */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    TickitWatch *head, **tailp; /* queue of work not yet started */
+    bool stopping;
+  } work;
+
+  struct LoopStats *loopstats; /* NULL until first enabled */
+
+  struct {
+    int throttle_msec;
+    void *timer;  /* non-NULL while throttling */
+    bool pending; /* a SIGWINCH arrived while throttling */
+  } resize;
+
   unsigned int done_setup    : 1,
-               use_altscreen : 1;
+               use_altscreen : 1,
+               loopstats_on  : 1;
 };
 
+static uint64_t now_usec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void record_loopstat(Tickit *t, TickitLoopStat which, uint64_t usec, TickitCallbackFn *fn)
+{
+  struct LoopStat *stat = &t->loopstats->stats[which];
+
+  int bucket = usec;
+  if(usec >= (1 << LOOPSTAT_SUBBITS)) {
+    int msb = 63 - __builtin_clzll(usec);
+    bucket = ((msb - LOOPSTAT_SUBBITS + 1) << LOOPSTAT_SUBBITS) +
+      ((usec >> (msb - LOOPSTAT_SUBBITS)) & ((1 << LOOPSTAT_SUBBITS) - 1));
+    if(bucket >= LOOPSTAT_NBUCKETS)
+      bucket = LOOPSTAT_NBUCKETS - 1;
+  }
+
+  stat->counts[bucket]++;
+  stat->count++;
+  stat->total_usec += usec;
+  if(usec >= stat->max_usec) {
+    stat->max_usec = usec;
+    stat->slowest  = fn;
+  }
+}
+
+/* Upper bound of the values counted in a bucket */
+static unsigned long loopstat_bucket_max(int bucket)
+{
+  if(bucket < (1 << LOOPSTAT_SUBBITS))
+    return bucket;
+
+  int shift = (bucket >> LOOPSTAT_SUBBITS) - 1;
+  int sub   = bucket & ((1 << LOOPSTAT_SUBBITS) - 1);
+  return ((unsigned long)((1 << LOOPSTAT_SUBBITS) + sub + 1) << shift) - 1;
+}
+
+static const TickitLoopStat watch_loopstat[] = {
+  [WATCH_IO]      = TICKIT_LOOPSTAT_IO,
+  [WATCH_TIMER]   = TICKIT_LOOPSTAT_TIMER,
+  [WATCH_LATER]   = TICKIT_LOOPSTAT_LATER,
+  [WATCH_SIGNAL]  = TICKIT_LOOPSTAT_SIGNAL,
+  [WATCH_PROCESS] = TICKIT_LOOPSTAT_PROCESS,
+  [WATCH_WORK]    = TICKIT_LOOPSTAT_WORK,
+};
+
+/* The callback may free the watch, so take everything we need first */
+static void fire_watch(TickitWatch *watch, TickitEventFlags flags, void *info)
+{
+  Tickit *t = watch->t;
+
+  if(!t->loopstats_on) {
+    (*watch->fn)(t, flags, info, watch->user);
+    return;
+  }
+
+  TickitLoopStat which = watch_loopstat[watch->type];
+  TickitCallbackFn *fn = watch->fn;
+
+  uint64_t start = now_usec();
+  (*fn)(t, flags, info, watch->user);
+  record_loopstat(t, which, now_usec() - start, fn);
+}
+
 static int on_term_timeout(Tickit *t, TickitEventFlags flags, void *info, void *user);
 static int on_term_timeout(Tickit *t, TickitEventFlags flags, void *info, void *user)
 {
@@ -108,36 +269,87 @@ static int on_term_readable(Tickit *t, TickitEventFlags flags, void *info, void
   return 0;
 }
 
-static Tickit *signal_observer;
-
-static void sighandler(int signum)
+/* A nonblocking pair of fds by which other threads or signal handlers can
+ * wake the event loop, by writing a uint64_t to fds[1]. Where possible this
+ * is a single eventfd, so both ends are the same fd.
+ */
+static bool open_wakeup(int fds[2])
 {
-  if(signal_observer) {
-    sigaddset(&signal_observer->signal.pending, signum);
-    write(signal_observer->signal.pipefds[1], "\0", 1);
+#if HAVE_EVENTFD
+  fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+  return fds[0] != -1;
+#else
+  if(pipe(fds) == -1)
+    return false;
+  for(int i = 0; i < 2; i++) {
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[i], F_SETFD, FD_CLOEXEC);
   }
+  return true;
+#endif
 }
 
-static int on_sigpipe_readable(Tickit *t, TickitEventFlags flags, void *info, void *user)
+static void close_wakeup(int fds[2])
 {
-  char buf[1];
-  read(t->signal.pipefds[0], &buf, 1);
+  if(fds[0] != -1)
+    close(fds[0]);
+  if(fds[1] != -1 && fds[1] != fds[0])
+    close(fds[1]);
 
-  sigset_t pending;
-  {
-    sigset_t orig;
-    sigprocmask(SIG_BLOCK, &t->signal.watched, &orig);
+  fds[0] = fds[1] = -1;
+}
 
-    pending = t->signal.pending;
-    sigemptyset(&t->signal.pending);
+static void wake(int fds[2])
+{
+  uint64_t one = 1;
+  write(fds[1], &one, sizeof one);
+}
 
-    sigprocmask(SIG_SETMASK, &orig, NULL);
-  }
+static void drain_wakeup(int fds[2])
+{
+  /* A single read resets an eventfd; a pipe needs emptying */
+  uint64_t buf[8];
+  while(read(fds[0], buf, sizeof buf) > 0 && !HAVE_EVENTFD)
+    ;
+}
+
+static int on_signal_readable(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  /* Any number of deliveries since we last looked, of any signals, collapse
+   * into a single dispatch of each. Clear the wakeup first so that a signal
+   * racing with us is either collected now or wakes us again.
+   */
+  drain_wakeup(t->signal.fds);
+
+  sigset_t pending;
+  tickit_sighub_take_pending(t->signal.sub, &pending);
 
   TickitWatch *this;
   for(this = t->signals; this; this = this->next) {
     if(sigismember(&pending, this->signal.signum))
-      (*this->fn)(this->t, TICKIT_EV_FIRE, NULL, this->user);
+      fire_watch(this, TICKIT_EV_FIRE, NULL);
+  }
+
+  return 0;
+}
+
+static int on_resize_timer(Tickit *t, TickitEventFlags flags, void *info, void *user);
+
+static void apply_resize(Tickit *t)
+{
+  tickit_term_refresh_size(t->term);
+
+  if(t->resize.throttle_msec > 0)
+    t->resize.timer = tickit_watch_timer_after_msec(t, t->resize.throttle_msec, 0, on_resize_timer, NULL);
+}
+
+static int on_resize_timer(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  t->resize.timer = NULL;
+
+  if(t->resize.pending) {
+    t->resize.pending = false;
+    apply_resize(t);
   }
 
   return 0;
@@ -148,7 +360,16 @@ static int on_sigwinch(Tickit *t, TickitEventFlags flags, void *info, void *user
   if(!t->term)
     return 0;
 
-  tickit_term_refresh_size(t->term);
+  /* Dragging the terminal window sends a storm of these. Apply the first one
+   * at once, then at most one more per interval; that one reads whatever the
+   * latest size is, so the intermediate ones are never laid out or drawn
+   */
+  if(t->resize.timer) {
+    t->resize.pending = true;
+    return 0;
+  }
+
+  apply_resize(t);
   return 0;
 }
 
@@ -156,7 +377,10 @@ static void setupterm(Tickit *t)
 {
   TickitTerm *tt = t->term;
 
-  tickit_term_await_started_msec(tt, 50);
+  /* Don't wait for the terminal to answer the driver's startup queries; the
+   * replies arrive as input through the event loop, and the root window
+   * redraws if they reveal anything that would improve the output
+   */
 
   if(t->use_altscreen)
     tickit_term_setctl_int(tt, TICKIT_TERMCTL_ALTSCREEN, 1);
@@ -175,6 +399,9 @@ static void teardownterm(Tickit *t)
   t->done_setup = false;
 }
 
+static bool setup_post(Tickit *t);
+static void teardown_post(Tickit *t);
+
 Tickit *tickit_build(const struct TickitBuilder *builder)
 {
   Tickit *t = malloc(sizeof(Tickit));
@@ -198,18 +425,35 @@ Tickit *tickit_build(const struct TickitBuilder *builder)
   t->laters    = NULL;
   t->signals   = NULL;
   t->processes = NULL;
+  t->works     = NULL;
 
-  t->signal.pipefds[0] = -1;
-  t->signal.pipewatch = NULL;
-  sigemptyset(&t->signal.watched);
-  sigemptyset(&t->signal.pending);
+  t->watchslabs  = NULL;
+  t->freewatches = NULL;
+
+  t->signal.fds[0] = t->signal.fds[1] = -1;
+  t->signal.sub = NULL;
+  t->signal.watch = NULL;
 
   t->sigchldwatch = NULL;
 
+  t->post.head = NULL;
+  t->post.fds[0] = t->post.fds[1] = -1;
+  t->post.watch = NULL;
+
+  t->work.nthreads = 0;
+  t->work.threads = NULL;
+
   t->done_setup = false;
 
   t->use_altscreen = true;
 
+  t->loopstats = NULL;
+  t->loopstats_on = false;
+
+  t->resize.throttle_msec = 16;
+  t->resize.timer = NULL;
+  t->resize.pending = false;
+
   TickitTerm *tt = builder->tt;
   if(!tt) {
     struct TickitTermBuilder term_builder = builder->term_builder;
@@ -227,6 +471,10 @@ Tickit *tickit_build(const struct TickitBuilder *builder)
 
   tickit_watch_signal(t, SIGWINCH, 0, on_sigwinch, NULL);
 
+  /* Must exist before any other thread can call tickit_post() */
+  if(!setup_post(t))
+    goto abort;
+
   return t;
 
 abort:
@@ -267,6 +515,36 @@ Tickit *tickit_new_stdtty(void)
   });
 }
 
+static TickitWatch *alloc_watch(Tickit *t)
+{
+  if(!t->freewatches) {
+    WatchSlab *slab = malloc(sizeof(WatchSlab));
+    if(!slab)
+      return NULL;
+
+    slab->next = t->watchslabs;
+    t->watchslabs = slab;
+
+    for(int i = 0; i < WATCHES_PER_SLAB; i++) {
+      slab->watches[i].next = t->freewatches;
+      t->freewatches = &slab->watches[i];
+    }
+  }
+
+  TickitWatch *watch = t->freewatches;
+  t->freewatches = watch->next;
+
+  return watch;
+}
+
+static void free_watch(Tickit *t, TickitWatch *watch)
+{
+  watch->type = WATCH_NONE;
+
+  watch->next = t->freewatches;
+  t->freewatches = watch;
+}
+
 static void insert_watch(TickitWatch **watchesptr, TickitBindFlags flags, TickitWatch *new)
 {
   if(!(flags & TICKIT_BIND_FIRST)) {
@@ -290,17 +568,25 @@ static void destroy_watchlist(Tickit *t, TickitWatch *watches, void (*cancelfunc
     if(cancelfunc)
       (*cancelfunc)(t->evdata, this);
 
-    free(this);
+    free_watch(t, this);
   }
 }
 
 static void invoke_watch(TickitWatch *watch, TickitEventFlags flags, void *info)
 {
-  (*watch->fn)(watch->t, flags, info, watch->user);
+  /* The callback may cancel a persistent watch, so don't look at it again
+   * afterwards unless we know it to be a oneshot still in its list
+   */
+  int type = watch->type;
+
+  if(flags & TICKIT_EV_FIRE)
+    fire_watch(watch, flags, info);
+  else
+    (*watch->fn)(watch->t, flags, info, watch->user);
 
   /* Remove oneshot watches from the list */
   TickitWatch **prevp;
-  switch(watch->type) {
+  switch(type) {
     case WATCH_NONE:
     case WATCH_IO:
     case WATCH_SIGNAL:
@@ -317,14 +603,16 @@ static void invoke_watch(TickitWatch *watch, TickitEventFlags flags, void *info)
     case WATCH_PROCESS:
       prevp = &watch->t->processes;
       break;
+
+    case WATCH_WORK:
+      prevp = &watch->t->works;
+      break;
   }
 
   while(*prevp) {
     if(*prevp == watch) {
       *prevp = watch->next;
-      watch->next = NULL;
-      watch->type = WATCH_NONE;
-      free(watch);
+      free_watch(watch->t, watch);
       return;
     }
 
@@ -332,6 +620,9 @@ static void invoke_watch(TickitWatch *watch, TickitEventFlags flags, void *info)
   }
 }
 
+static void release_pidfd(Tickit *t, TickitWatch *watch);
+static void stop_workers(Tickit *t);
+
 static void tickit_destroy(Tickit *t)
 {
   if(t->done_setup)
@@ -344,17 +635,22 @@ static void tickit_destroy(Tickit *t)
     tickit_term_unref(t->term);
   }
 
+  /* Workers may still post completions, so stop them first */
+  stop_workers(t);
+  teardown_post(t);
+
   if(t->sigchldwatch)
     tickit_watch_cancel(t, t->sigchldwatch);
 
-  if(t->signal.pipewatch)
-    tickit_watch_cancel(t, t->signal.pipewatch);
-  for(int signum = 1; signum < NSIG; signum++) {
-    if(sigismember(&t->signal.watched, signum))
-      sigaction(signum, &(struct sigaction){ .sa_handler = SIG_DFL }, NULL);
-  }
-  if(signal_observer == t)
-    signal_observer = NULL;
+  for(TickitWatch *this = t->processes; this; this = this->next)
+    release_pidfd(t, this);
+
+  /* Other instances may still be watching the same signals */
+  if(t->signal.sub)
+    tickit_sighub_unsubscribe(t->signal.sub);
+  if(t->signal.watch)
+    tickit_watch_cancel(t, t->signal.watch);
+  close_wakeup(t->signal.fds);
 
   if(t->iowatches)
     destroy_watchlist(t, t->iowatches, t->evhooks->cancel_io);
@@ -366,9 +662,20 @@ static void tickit_destroy(Tickit *t)
     destroy_watchlist(t, t->signals, t->evhooks->cancel_signal);
   if(t->processes)
     destroy_watchlist(t, t->processes, t->evhooks->cancel_process);
+  if(t->works)
+    destroy_watchlist(t, t->works, NULL);
 
   (*t->evhooks->destroy)(t->evdata);
 
+  if(t->loopstats)
+    free(t->loopstats);
+
+  while(t->watchslabs) {
+    WatchSlab *next = t->watchslabs->next;
+    free(t->watchslabs);
+    t->watchslabs = next;
+  }
+
   free(t);
 }
 
@@ -406,6 +713,18 @@ bool tickit_getctl_int(Tickit *t, TickitCtl ctl, int *value)
       *value = t->use_altscreen;
       return true;
 
+    case TICKIT_CTL_WORKER_THREADS:
+      *value = t->work.nthreads;
+      return true;
+
+    case TICKIT_CTL_LOOPSTATS:
+      *value = t->loopstats_on;
+      return true;
+
+    case TICKIT_CTL_RESIZE_THROTTLE_MSEC:
+      *value = t->resize.throttle_msec;
+      return true;
+
     case TICKIT_N_CTLS:
       ;
   }
@@ -419,6 +738,31 @@ bool tickit_setctl_int(Tickit *t, TickitCtl ctl, int value)
       t->use_altscreen = value;
       return true;
 
+    case TICKIT_CTL_WORKER_THREADS:
+      /* The pool is fixed-size once started */
+      if(t->work.threads || value < 0)
+        return false;
+      t->work.nthreads = value;
+      return true;
+
+    case TICKIT_CTL_LOOPSTATS:
+      if(value && !t->loopstats_on) {
+        /* Each enabling starts a fresh set of statistics */
+        if(!t->loopstats)
+          t->loopstats = malloc(sizeof(struct LoopStats));
+        if(!t->loopstats)
+          return false;
+        memset(t->loopstats, 0, sizeof(struct LoopStats));
+      }
+      t->loopstats_on = !!value;
+      return true;
+
+    case TICKIT_CTL_RESIZE_THROTTLE_MSEC:
+      if(value < 0)
+        return false;
+      t->resize.throttle_msec = value;
+      return true;
+
     case TICKIT_N_CTLS:
       ;
   }
@@ -458,7 +802,7 @@ void tickit_stop(Tickit *t)
 
 void *tickit_watch_io(Tickit *t, int fd, TickitIOCondition cond, TickitBindFlags flags, TickitCallbackFn *fn, void *user)
 {
-  TickitWatch *watch = malloc(sizeof(TickitWatch));
+  TickitWatch *watch = alloc_watch(t);
   if(!watch)
     return NULL;
 
@@ -481,7 +825,7 @@ void *tickit_watch_io(Tickit *t, int fd, TickitIOCondition cond, TickitBindFlags
   return watch;
 
 fail:
-  free(watch);
+  free_watch(t, watch);
   return NULL;
 }
 
@@ -492,7 +836,7 @@ void *tickit_watch_io_read(Tickit *t, int fd, TickitBindFlags flags, TickitCallb
 
 void *tickit_watch_timer_at_tv(Tickit *t, const struct timeval *at, TickitBindFlags flags, TickitCallbackFn *fn, void *user)
 {
-  TickitWatch *watch = malloc(sizeof(TickitWatch));
+  TickitWatch *watch = alloc_watch(t);
   if(!watch)
     return NULL;
 
@@ -521,7 +865,7 @@ void *tickit_watch_timer_at_tv(Tickit *t, const struct timeval *at, TickitBindFl
   return watch;
 
 fail:
-  free(watch);
+  free_watch(t, watch);
   return NULL;
 }
 
@@ -554,7 +898,7 @@ void *tickit_watch_timer_after_msec(Tickit *t, int msec, TickitBindFlags flags,
 
 void *tickit_watch_later(Tickit *t, TickitBindFlags flags, TickitCallbackFn *fn, void *user)
 {
-  TickitWatch *watch = malloc(sizeof(TickitWatch));
+  TickitWatch *watch = alloc_watch(t);
   if(!watch)
     return NULL;
 
@@ -575,25 +919,26 @@ void *tickit_watch_later(Tickit *t, TickitBindFlags flags, TickitCallbackFn *fn,
   return watch;
 
 fail:
-  free(watch);
+  free_watch(t, watch);
   return NULL;
 }
 
-static void watch_signal(Tickit *t, int signum, TickitWatch *watch)
+static bool watch_signal(Tickit *t, int signum)
 {
-  if(t->signal.pipefds[0] == -1) {
-    pipe(t->signal.pipefds);
-    t->signal.pipewatch = tickit_watch_io(t, t->signal.pipefds[0], TICKIT_IO_IN, 0, &on_sigpipe_readable, t);
-  }
-
-  if(sigismember(&t->signal.watched, signum))
-    return;
+  if(!t->signal.sub) {
+    if(!open_wakeup(t->signal.fds))
+      return false;
+
+    t->signal.sub = tickit_sighub_subscribe(t->signal.fds[1]);
+    if(!t->signal.sub) {
+      close_wakeup(t->signal.fds);
+      return false;
+    }
 
-  sigaction(signum, &(struct sigaction){ .sa_handler = sighandler }, NULL);
-  sigaddset(&t->signal.watched, signum);
+    t->signal.watch = tickit_watch_io(t, t->signal.fds[0], TICKIT_IO_IN, 0, &on_signal_readable, NULL);
+  }
 
-  if(!signal_observer)
-    signal_observer = t;
+  return tickit_sighub_watch(t->signal.sub, signum);
 }
 
 static void unwatch_signal(Tickit *t, TickitWatch *watch)
@@ -607,13 +952,12 @@ static void unwatch_signal(Tickit *t, TickitWatch *watch)
       return;
   }
 
-  sigdelset(&t->signal.watched, signum);
-  sigaction(signum, &(struct sigaction){ .sa_handler = SIG_DFL }, NULL);
+  tickit_sighub_unwatch(t->signal.sub, signum);
 }
 
 void *tickit_watch_signal(Tickit *t, int signum, TickitBindFlags flags, TickitCallbackFn *fn, void *user)
 {
-  TickitWatch *watch = malloc(sizeof(TickitWatch));
+  TickitWatch *watch = alloc_watch(t);
   if(!watch)
     return NULL;
 
@@ -629,11 +973,16 @@ void *tickit_watch_signal(Tickit *t, int signum, TickitBindFlags flags, TickitCa
 
   if(!t->evhooks->signal ||
       !(*t->evhooks->signal)(t->evdata, signum, flags, watch))
-    watch_signal(t, signum, watch);
+    if(!watch_signal(t, signum))
+      goto fail;
 
   insert_watch(&t->signals, flags, watch);
 
   return watch;
+
+fail:
+  free_watch(t, watch);
+  return NULL;
 }
 
 static int on_sigchld(Tickit *t, TickitEventFlags flags, void *info, void *data)
@@ -642,6 +991,9 @@ static int on_sigchld(Tickit *t, TickitEventFlags flags, void *info, void *data)
   for(this = t->processes; this; this = next) {
     next = this->next;
 
+    if(this->process.pidfd != -1)
+      continue;
+
     TickitProcessWatchInfo info;
     if(waitpid(this->process.pid, &info.wstatus, WNOHANG) <= 0)
       continue;
@@ -661,9 +1013,68 @@ static int process_notify(Tickit *t, TickitEventFlags flags, void *_info, void *
   return 0;
 }
 
+static void release_pidfd(Tickit *t, TickitWatch *watch)
+{
+  if(watch->process.pidfd == -1)
+    return;
+
+  if(watch->process.pidfdwatch)
+    tickit_watch_cancel(t, watch->process.pidfdwatch);
+  close(watch->process.pidfd);
+
+  watch->process.pidfd = -1;
+  watch->process.pidfdwatch = NULL;
+}
+
+static int on_pidfd_readable(Tickit *t, TickitEventFlags flags, void *_info, void *data)
+{
+  TickitWatch *watch = data;
+
+  TickitProcessWatchInfo info;
+  pid_t ret = waitpid(watch->process.pid, &info.wstatus, WNOHANG);
+  if(ret == 0)
+    return 0;
+
+  release_pidfd(t, watch);
+  if(ret < 0)
+    /* Somebody else reaped it; as with SIGCHLD we'll never see its status */
+    return 0;
+
+  info.pid = watch->process.pid;
+  invoke_watch(watch, TICKIT_EV_FIRE, &info);
+
+  return 0;
+}
+
+/* A pidfd becomes readable when its process exits, so each process watch is
+ * just another IO watch and an exit costs O(1) rather than a waitpid() sweep
+ * of every watched process on every SIGCHLD
+ */
+static bool watch_pidfd(Tickit *t, TickitWatch *watch)
+{
+#if HAVE_PIDFD
+  int pidfd = syscall(SYS_pidfd_open, watch->process.pid, 0);
+  if(pidfd == -1)
+    return false;
+
+  fcntl(pidfd, F_SETFD, FD_CLOEXEC);
+
+  watch->process.pidfdwatch = tickit_watch_io(t, pidfd, TICKIT_IO_IN, 0, &on_pidfd_readable, watch);
+  if(!watch->process.pidfdwatch) {
+    close(pidfd);
+    return false;
+  }
+
+  watch->process.pidfd = pidfd;
+  return true;
+#else
+  return false;
+#endif
+}
+
 void *tickit_watch_process(Tickit *t, pid_t pid, TickitBindFlags flags, TickitCallbackFn *fn, void *user)
 {
-  TickitWatch *watch = malloc(sizeof(TickitWatch));
+  TickitWatch *watch = alloc_watch(t);
   if(!watch)
     return NULL;
 
@@ -676,10 +1087,12 @@ void *tickit_watch_process(Tickit *t, pid_t pid, TickitBindFlags flags, TickitCa
   watch->user = user;
 
   watch->process.pid = pid;
+  watch->process.pidfd = -1;
+  watch->process.pidfdwatch = NULL;
 
   if(!t->evhooks->process ||
       !(*t->evhooks->process)(t->evdata, pid, flags, watch)) {
-    if(!t->sigchldwatch)
+    if(!watch_pidfd(t, watch) && !t->sigchldwatch)
       t->sigchldwatch = tickit_watch_signal(t, SIGCHLD, 0, &on_sigchld, NULL);
 
     if(waitpid(pid, &watch->process.wstatus, WNOHANG) > 0) {
@@ -687,6 +1100,7 @@ void *tickit_watch_process(Tickit *t, pid_t pid, TickitBindFlags flags, TickitCa
        * callback immediately as user will be expecting it to only be called via
        * tickit_run(). We'll install a later handler for it
        */
+      release_pidfd(t, watch);
       tickit_watch_later(t, 0, process_notify, watch);
 
       return watch;
@@ -698,6 +1112,269 @@ void *tickit_watch_process(Tickit *t, pid_t pid, TickitBindFlags flags, TickitCa
   return watch;
 }
 
+/* Takes the entire queue at once, returning it in the order it was posted */
+static TickitPost *take_posts(Tickit *t)
+{
+  TickitPost *newest = __atomic_exchange_n(&t->post.head, NULL, __ATOMIC_ACQ_REL);
+
+  TickitPost *oldest = NULL;
+  while(newest) {
+    TickitPost *next = newest->next;
+    newest->next = oldest;
+    oldest = newest;
+    newest = next;
+  }
+
+  return oldest;
+}
+
+static int on_post_readable(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  /* Clear the wakeup before taking the queue, so that a post racing with us
+   * either lands in this batch or wakes us again
+   */
+  drain_wakeup(t->post.fds);
+
+  TickitPost *post = take_posts(t);
+  while(post) {
+    (*post->fn)(t, TICKIT_EV_FIRE|TICKIT_EV_UNBIND, NULL, post->user);
+
+    TickitPost *next = post->next;
+    free(post);
+    post = next;
+  }
+
+  return 0;
+}
+
+static bool setup_post(Tickit *t)
+{
+  if(!open_wakeup(t->post.fds))
+    return false;
+
+  t->post.watch = tickit_watch_io(t, t->post.fds[0], TICKIT_IO_IN, 0, &on_post_readable, NULL);
+  return t->post.watch != NULL;
+}
+
+static void teardown_post(Tickit *t)
+{
+  if(t->post.watch)
+    tickit_watch_cancel(t, t->post.watch);
+
+  close_wakeup(t->post.fds);
+
+  TickitPost *post = take_posts(t);
+  while(post) {
+    if(post->flags & (TICKIT_BIND_UNBIND|TICKIT_BIND_DESTROY))
+      (*post->fn)(t, TICKIT_EV_UNBIND|TICKIT_EV_DESTROY, NULL, post->user);
+
+    TickitPost *next = post->next;
+    free(post);
+    post = next;
+  }
+}
+
+bool tickit_post(Tickit *t, TickitBindFlags flags, TickitCallbackFn *fn, void *user)
+{
+  TickitPost *post = malloc(sizeof(TickitPost));
+  if(!post)
+    return false;
+
+  post->flags = flags & (TICKIT_BIND_UNBIND|TICKIT_BIND_DESTROY);
+  post->fn    = fn;
+  post->user  = user;
+
+  TickitPost *head = __atomic_load_n(&t->post.head, __ATOMIC_RELAXED);
+  do
+    post->next = head;
+  while(!__atomic_compare_exchange_n(&t->post.head, &head, post,
+        true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  /* Only the post that finds the queue empty needs to wake the loop; any
+   * others will be collected by that same wakeup
+   */
+  if(!head)
+    wake(t->post.fds);
+
+  return true;
+}
+
+static int on_work_done(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  TickitWatch *watch = user;
+
+  if(watch->work.cancelled)
+    /* Already removed from t->works by tickit_watch_cancel() */
+    free_watch(t, watch);
+  else if(flags & TICKIT_EV_FIRE)
+    invoke_watch(watch, TICKIT_EV_FIRE|TICKIT_EV_UNBIND, NULL);
+  /* else the toplevel is being destroyed, and destroy_watchlist() will find
+   * it still in t->works */
+
+  return 0;
+}
+
+static void *run_worker(void *data)
+{
+  Tickit *t = data;
+
+  pthread_mutex_lock(&t->work.lock);
+  while(1) {
+    while(!t->work.head && !t->work.stopping)
+      pthread_cond_wait(&t->work.cond, &t->work.lock);
+    if(t->work.stopping)
+      break;
+
+    TickitWatch *watch = t->work.head;
+    t->work.head = watch->work.qnext;
+    if(!t->work.head)
+      t->work.tailp = &t->work.head;
+    watch->work.started = true;
+
+    pthread_mutex_unlock(&t->work.lock);
+
+    (*watch->work.fn)(watch->user);
+    tickit_post(t, TICKIT_BIND_DESTROY, &on_work_done, watch);
+
+    pthread_mutex_lock(&t->work.lock);
+  }
+  pthread_mutex_unlock(&t->work.lock);
+
+  return NULL;
+}
+
+static bool start_workers(Tickit *t)
+{
+  int nthreads = t->work.nthreads;
+  if(!nthreads)
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  if(nthreads < 1)
+    nthreads = 1;
+
+  t->work.threads = malloc(nthreads * sizeof(pthread_t));
+  if(!t->work.threads)
+    return false;
+
+  pthread_mutex_init(&t->work.lock, NULL);
+  pthread_cond_init(&t->work.cond, NULL);
+  t->work.head = NULL;
+  t->work.tailp = &t->work.head;
+  t->work.stopping = false;
+
+  /* Workers inherit our signal mask; keep every signal off them, so that no
+   * handler can interrupt a blocking call made by some work. SA_RESTART
+   * doesn't cover them all; poll() and sleeps still fail with EINTR.
+   */
+  sigset_t allsigs, oldmask;
+  sigfillset(&allsigs);
+  pthread_sigmask(SIG_BLOCK, &allsigs, &oldmask);
+
+  int started;
+  for(started = 0; started < nthreads; started++)
+    if(pthread_create(&t->work.threads[started], NULL, &run_worker, t) != 0)
+      break;
+
+  pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+
+  if(!started) {
+    pthread_cond_destroy(&t->work.cond);
+    pthread_mutex_destroy(&t->work.lock);
+    free(t->work.threads);
+    t->work.threads = NULL;
+    return false;
+  }
+
+  t->work.nthreads = started;
+  return true;
+}
+
+static void stop_workers(Tickit *t)
+{
+  if(!t->work.threads)
+    return;
+
+  pthread_mutex_lock(&t->work.lock);
+  t->work.stopping = true;
+  pthread_cond_broadcast(&t->work.cond);
+  pthread_mutex_unlock(&t->work.lock);
+
+  /* Work already started is allowed to finish; anything still queued is left
+   * in t->works for destroy_watchlist() */
+  for(int i = 0; i < t->work.nthreads; i++)
+    pthread_join(t->work.threads[i], NULL);
+
+  pthread_cond_destroy(&t->work.cond);
+  pthread_mutex_destroy(&t->work.lock);
+  free(t->work.threads);
+  t->work.threads = NULL;
+}
+
+/* Returns false if a worker has already taken it */
+static bool unqueue_work(Tickit *t, TickitWatch *watch)
+{
+  pthread_mutex_lock(&t->work.lock);
+
+  bool queued = !watch->work.started;
+  if(queued) {
+    TickitWatch **prevp = &t->work.head;
+    while(*prevp != watch)
+      prevp = &(*prevp)->work.qnext;
+
+    *prevp = watch->work.qnext;
+    if(!*prevp)
+      t->work.tailp = prevp;
+  }
+  else
+    watch->work.cancelled = true;
+
+  pthread_mutex_unlock(&t->work.lock);
+
+  return queued;
+}
+
+void *tickit_watch_work(Tickit *t, TickitBindFlags flags, TickitWorkFn *fn_work, TickitCallbackFn *fn_done, void *user)
+{
+  if(!t->work.threads && !start_workers(t))
+    return NULL;
+
+  TickitWatch *watch = alloc_watch(t);
+  if(!watch)
+    return NULL;
+
+  watch->next = NULL;
+  watch->t    = t;
+  watch->type = WATCH_WORK;
+
+  watch->flags = flags & (TICKIT_BIND_UNBIND|TICKIT_BIND_DESTROY);
+  watch->fn = fn_done;
+  watch->user = user;
+
+  watch->work.fn = fn_work;
+  watch->work.started = false;
+  watch->work.cancelled = false;
+
+  insert_watch(&t->works, flags, watch);
+
+  pthread_mutex_lock(&t->work.lock);
+
+  if(flags & TICKIT_BIND_FIRST) {
+    watch->work.qnext = t->work.head;
+    t->work.head = watch;
+    if(!watch->work.qnext)
+      t->work.tailp = &watch->work.qnext;
+  }
+  else {
+    watch->work.qnext = NULL;
+    *t->work.tailp = watch;
+    t->work.tailp = &watch->work.qnext;
+  }
+
+  pthread_cond_signal(&t->work.cond);
+  pthread_mutex_unlock(&t->work.lock);
+
+  return watch;
+}
+
 void tickit_watch_cancel(Tickit *t, void *_watch)
 {
   TickitWatch *watch = _watch;
@@ -719,6 +1396,9 @@ void tickit_watch_cancel(Tickit *t, void *_watch)
     case WATCH_PROCESS:
       thisp = &t->processes;
       break;
+    case WATCH_WORK:
+      thisp = &t->works;
+      break;
 
     case WATCH_NONE:
       return;
@@ -753,13 +1433,20 @@ void tickit_watch_cancel(Tickit *t, void *_watch)
         case WATCH_PROCESS:
           if(t->evhooks->cancel_process)
             (*t->evhooks->cancel_process)(t->evdata, this);
+          else
+            release_pidfd(t, this);
+          break;
+        case WATCH_WORK:
+          /* Once started, on_work_done() frees it after the worker finishes */
+          if(!unqueue_work(t, this))
+            continue;
           break;
 
         case WATCH_NONE:
           ;
       }
 
-      free(this);
+      free_watch(t, this);
     }
 
     if(!thisp || !*thisp)
@@ -801,30 +1488,29 @@ void tickit_evloop_invoke_timers(Tickit *t)
     gettimeofday(&now, NULL);
 
     /* timer queue is stored ordered, so we can just eat a prefix
-     * of it
+     * of it. Unlink each one before invoking it, so a callback that adds
+     * another timer never sees one already freed
      */
 
-    TickitWatch *this = t->timers;
-    while(this) {
+    TickitWatch *this;
+    while((this = t->timers)) {
       if(timercmp(&this->timer.at, &now, >))
         break;
 
+      t->timers = this->next;
+
       /* TODO: consider what info might point at */
-      (*this->fn)(this->t, TICKIT_EV_FIRE|TICKIT_EV_UNBIND, NULL, this->user);
+      fire_watch(this, TICKIT_EV_FIRE|TICKIT_EV_UNBIND, NULL);
 
-      TickitWatch *next = this->next;
-      free(this);
-      this = next;
+      free_watch(t, this);
     }
-
-    t->timers = this;
   }
 
   while(later) {
-    (*later->fn)(later->t, TICKIT_EV_FIRE|TICKIT_EV_UNBIND, NULL, later->user);
+    fire_watch(later, TICKIT_EV_FIRE|TICKIT_EV_UNBIND, NULL);
 
     TickitWatch *next = later->next;
-    free(later);
+    free_watch(t, later);
     later = next;
   }
 }
@@ -875,10 +1561,40 @@ void tickit_evloop_invoke_sigwatches(Tickit *t, int signum)
   TickitWatch *this;
   for(this = t->signals; this; this = this->next) {
     if(this->signal.signum == signum)
-      (*this->fn)(this->t, TICKIT_EV_FIRE, NULL, this->user);
+      fire_watch(this, TICKIT_EV_FIRE, NULL);
   }
 }
 
+void tickit_evloop_poll_begin(Tickit *t)
+{
+  if(!t->loopstats_on)
+    return;
+
+  t->loopstats->poll_begin = now_usec();
+}
+
+void tickit_evloop_poll_end(Tickit *t)
+{
+  if(!t->loopstats_on)
+    return;
+
+  struct LoopStats *ls = t->loopstats;
+  ls->poll_end = now_usec();
+  /* Statistics may have been enabled while blocked */
+  if(ls->poll_begin)
+    record_loopstat(t, TICKIT_LOOPSTAT_POLL, ls->poll_end - ls->poll_begin, NULL);
+}
+
+void tickit_evloop_iteration_end(Tickit *t)
+{
+  if(!t->loopstats_on)
+    return;
+
+  struct LoopStats *ls = t->loopstats;
+  if(ls->poll_end)
+    record_loopstat(t, TICKIT_LOOPSTAT_ITERATION, now_usec() - ls->poll_end, NULL);
+}
+
 void tickit_evloop_sigwinch(Tickit *t)
 {
   /* No longer need to do anything, as on_sigwinch() has already handled it
@@ -886,10 +1602,79 @@ void tickit_evloop_sigwinch(Tickit *t)
    */
 }
 
+const char *tickit_loopstat_name(TickitLoopStat stat)
+{
+  switch(stat) {
+    case TICKIT_LOOPSTAT_ITERATION: return "iteration";
+    case TICKIT_LOOPSTAT_POLL:      return "poll";
+    case TICKIT_LOOPSTAT_IO:        return "io";
+    case TICKIT_LOOPSTAT_TIMER:     return "timer";
+    case TICKIT_LOOPSTAT_LATER:     return "later";
+    case TICKIT_LOOPSTAT_SIGNAL:    return "signal";
+    case TICKIT_LOOPSTAT_PROCESS:   return "process";
+    case TICKIT_LOOPSTAT_WORK:      return "work";
+
+    case TICKIT_N_LOOPSTATS: ;
+  }
+  return NULL;
+}
+
+bool tickit_get_loopstat(Tickit *t, TickitLoopStat which, TickitLoopStatInfo *info)
+{
+  if(!t->loopstats || which < 0 || which >= TICKIT_N_LOOPSTATS)
+    return false;
+
+  struct LoopStat *stat = &t->loopstats->stats[which];
+
+  info->count      = stat->count;
+  info->total_usec = stat->total_usec;
+  info->max_usec   = stat->max_usec;
+  info->slowest    = stat->slowest;
+
+  unsigned long *pcts[] = { &info->p50_usec, &info->p90_usec, &info->p99_usec };
+  const int pct[]       = { 50,              90,              99              };
+
+  unsigned long seen = 0;
+  int bucket = 0;
+  for(int i = 0; i < 3; i++) {
+    /* the smallest bucket by which at least pct% of samples have been seen */
+    unsigned long want = (stat->count * pct[i] + 99) / 100;
+    while(bucket < LOOPSTAT_NBUCKETS - 1 && seen + stat->counts[bucket] < want)
+      seen += stat->counts[bucket++];
+
+    unsigned long max = loopstat_bucket_max(bucket);
+    *pcts[i] = stat->count ? (max < stat->max_usec ? max : stat->max_usec) : 0;
+  }
+
+  return true;
+}
+
+void tickit_dump_loopstats(Tickit *t, FILE *fh)
+{
+  fprintf(fh, "%-10s %10s %12s %10s %10s %10s %10s\n",
+      "", "count", "total(us)", "p50(us)", "p90(us)", "p99(us)", "max(us)");
+
+  for(TickitLoopStat which = 0; which < TICKIT_N_LOOPSTATS; which++) {
+    TickitLoopStatInfo info;
+    if(!tickit_get_loopstat(t, which, &info))
+      return;
+
+    fprintf(fh, "%-10s %10lu %12lu %10lu %10lu %10lu %10lu",
+        tickit_loopstat_name(which), info.count, info.total_usec,
+        info.p50_usec, info.p90_usec, info.p99_usec, info.max_usec);
+    if(info.slowest)
+      fprintf(fh, "  slowest=%p", (void *)info.slowest);
+    fprintf(fh, "\n");
+  }
+}
+
 const char *tickit_ctl_name(TickitCtl ctl)
 {
   switch(ctl) {
     case TICKIT_CTL_USE_ALTSCREEN: return "use-altscreen";
+    case TICKIT_CTL_WORKER_THREADS: return "worker-threads";
+    case TICKIT_CTL_LOOPSTATS: return "loopstats";
+    case TICKIT_CTL_RESIZE_THROTTLE_MSEC: return "resize-throttle-msec";
 
     case TICKIT_N_CTLS: ;
   }
@@ -911,8 +1696,13 @@ TickitType tickit_ctl_type(TickitCtl ctl)
 {
   switch(ctl) {
     case TICKIT_CTL_USE_ALTSCREEN:
+    case TICKIT_CTL_LOOPSTATS:
       return TICKIT_TYPE_BOOL;
 
+    case TICKIT_CTL_WORKER_THREADS:
+    case TICKIT_CTL_RESIZE_THROTTLE_MSEC:
+      return TICKIT_TYPE_INT;
+
     case TICKIT_N_CTLS:
       ;
   }
@@ -0,0 +1,199 @@
+#include "tickit.h"
+
+struct TickitViewport {
+  TickitWindow *win;
+
+  int content_lines, content_cols;
+  int scroll_line, scroll_col;
+
+  TickitViewportRowFn *fn;
+  void *user;
+
+  int event_ids[2];
+};
+
+static inline int minint(int a, int b) { return a < b ? a : b; }
+static inline int maxint(int a, int b) { return a > b ? a : b; }
+
+static int on_expose(TickitWindow *win, TickitEventFlags flags, void *_info, void *user)
+{
+  TickitViewport *vp = user;
+  TickitExposeEventInfo *info = _info;
+
+  TickitRenderBuffer *rb = info->rb;
+  const TickitRect *rect = &info->rect;
+
+  for(int line = rect->top; line < tickit_rect_bottom(rect); line++) {
+    TickitRect linerect = { .top = line, .left = rect->left, .lines = 1, .cols = rect->cols };
+    if(info->visible && !tickit_rectset_intersects(info->visible, &linerect))
+      continue;
+
+    tickit_renderbuffer_erase_at(rb, line, rect->left, rect->cols);
+
+    int row  = vp->scroll_line + line;
+    int left = vp->scroll_col + rect->left;
+    int cols = minint(rect->cols, vp->content_cols - left);
+
+    if(row >= vp->content_lines || cols <= 0)
+      continue;
+
+    tickit_renderbuffer_save(rb);
+
+    tickit_renderbuffer_clip(rb, &linerect);
+    tickit_renderbuffer_translate(rb, line, -vp->scroll_col);
+
+    TickitViewportRowInfo rowinfo = {
+      .row  = row,
+      .left = left,
+      .cols = cols,
+      .rb   = rb,
+    };
+    (*vp->fn)(vp, &rowinfo, vp->user);
+
+    tickit_renderbuffer_restore(rb);
+  }
+
+  return 1;
+}
+
+/* Keeps the scroll offset within the content, returning true if it moved */
+static bool clamp_scroll(TickitViewport *vp)
+{
+  TickitRect geom = tickit_window_get_geometry(vp->win);
+
+  int line = minint(vp->scroll_line, maxint(0, vp->content_lines - geom.lines));
+  int col  = minint(vp->scroll_col,  maxint(0, vp->content_cols  - geom.cols));
+
+  if(line == vp->scroll_line && col == vp->scroll_col)
+    return false;
+
+  vp->scroll_line = line;
+  vp->scroll_col  = col;
+  return true;
+}
+
+static int on_geomchange(TickitWindow *win, TickitEventFlags flags, void *_info, void *user)
+{
+  TickitViewport *vp = user;
+
+  if(clamp_scroll(vp))
+    tickit_window_expose(win, NULL);
+
+  return 1;
+}
+
+TickitViewport *tickit_viewport_new(TickitWindow *win, TickitViewportRowFn *fn, void *user)
+{
+  TickitViewport *vp = malloc(sizeof(TickitViewport));
+  if(!vp)
+    return NULL;
+
+  vp->win = tickit_window_ref(win);
+
+  vp->content_lines = 0;
+  vp->content_cols  = 0;
+  vp->scroll_line   = 0;
+  vp->scroll_col    = 0;
+
+  vp->fn   = fn;
+  vp->user = user;
+
+  vp->event_ids[0] = tickit_window_bind_event(win, TICKIT_WINDOW_ON_EXPOSE, 0,
+      &on_expose, vp);
+  vp->event_ids[1] = tickit_window_bind_event(win, TICKIT_WINDOW_ON_GEOMCHANGE, 0,
+      &on_geomchange, vp);
+
+  tickit_window_expose(win, NULL);
+
+  return vp;
+}
+
+void tickit_viewport_destroy(TickitViewport *vp)
+{
+  tickit_window_unbind_event_id(vp->win, vp->event_ids[0]);
+  tickit_window_unbind_event_id(vp->win, vp->event_ids[1]);
+
+  tickit_window_unref(vp->win);
+
+  free(vp);
+}
+
+TickitWindow *tickit_viewport_get_window(const TickitViewport *vp)
+{
+  return vp->win;
+}
+
+void tickit_viewport_get_content_size(const TickitViewport *vp, int *lines, int *cols)
+{
+  if(lines)
+    *lines = vp->content_lines;
+  if(cols)
+    *cols = vp->content_cols;
+}
+
+void tickit_viewport_set_content_size(TickitViewport *vp, int lines, int cols)
+{
+  int oldlines = vp->content_lines;
+  int oldcols  = vp->content_cols;
+
+  vp->content_lines = maxint(0, lines);
+  vp->content_cols  = maxint(0, cols);
+
+  if(clamp_scroll(vp) || vp->content_cols != oldcols) {
+    tickit_window_expose(vp->win, NULL);
+    return;
+  }
+
+  /* Only the rows that have appeared or disappeared need redrawing */
+  if(vp->content_lines != oldlines) {
+    int top = minint(oldlines, vp->content_lines) - vp->scroll_line;
+    int bottom = maxint(oldlines, vp->content_lines) - vp->scroll_line;
+
+    tickit_window_expose(vp->win, &(TickitRect){
+        .top = top, .lines = bottom - top,
+        .left = 0,  .cols = tickit_window_cols(vp->win),
+    });
+  }
+}
+
+void tickit_viewport_get_scroll(const TickitViewport *vp, int *line, int *col)
+{
+  if(line)
+    *line = vp->scroll_line;
+  if(col)
+    *col = vp->scroll_col;
+}
+
+void tickit_viewport_scroll_to(TickitViewport *vp, int line, int col)
+{
+  int oldline = vp->scroll_line;
+  int oldcol  = vp->scroll_col;
+
+  vp->scroll_line = maxint(0, line);
+  vp->scroll_col  = maxint(0, col);
+  clamp_scroll(vp);
+
+  int downward  = vp->scroll_line - oldline;
+  int rightward = vp->scroll_col  - oldcol;
+
+  if(!downward && !rightward)
+    return;
+
+  /* Scrolling the window exposes just the strips that have come into view;
+   * they are rendered at the next flush, using the new offset
+   */
+  tickit_window_scroll(vp->win, downward, rightward);
+}
+
+void tickit_viewport_scroll(TickitViewport *vp, int downward, int rightward)
+{
+  tickit_viewport_scroll_to(vp, vp->scroll_line + downward, vp->scroll_col + rightward);
+}
+
+void tickit_viewport_expose_rows(TickitViewport *vp, int row, int count)
+{
+  tickit_window_expose(vp->win, &(TickitRect){
+      .top = row - vp->scroll_line, .lines = count,
+      .left = 0,                    .cols = tickit_window_cols(vp->win),
+  });
+}
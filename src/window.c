@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <sys/time.h>
+
 #define streq(a,b) (!strcmp(a,b))
 
 #define ROOT_AS_WINDOW(root) ((TickitWindow*)root)
@@ -21,6 +23,10 @@ typedef enum {
   TICKIT_HIERARCHY_LOWER_BACK
 } HierarchyChangeType;
 
+typedef struct ChildIndex ChildIndex;
+typedef struct KeyMap KeyMap;
+typedef struct KeyLookup KeyLookup;
+
 struct TickitWindow {
   TickitWindow *parent;
   TickitWindow *first_child;
@@ -28,6 +34,7 @@ struct TickitWindow {
   TickitWindow *focused_child;
   TickitPen *pen;
   TickitRect rect;
+  TickitRect abs_rect; /* cached; valid only while abs_valid */
   struct {
     int line;
     int col;
@@ -42,18 +49,58 @@ struct TickitWindow {
   unsigned int is_closed          : 1;
   unsigned int steal_input        : 1;
   unsigned int focus_child_notify : 1;
+  unsigned int abs_valid          : 1; /* if set, so is every ancestor's */
+  unsigned int keys_valid         : 1; /* if clear, so is every ancestor's */
+  unsigned int keys_any           : 1; /* subtree has TICKIT_WINDOW_ON_KEY handlers */
+
+  ChildIndex *child_index; /* NULL unless TICKIT_WINCTL_CHILD_INDEX */
+  int zorder;              /* position among siblings; valid while the parent's index is */
+
+  /* With TICKIT_WINCTL_CACHED, the window's last rendering and the parts of
+   * it that the window itself has since exposed */
+  TickitRenderBuffer *cache;
+  TickitRectSet *cache_dirty;
+
+  KeyMap *keymap;      /* NULL until a key is bound */
+  uint64_t keys_bloom; /* keys bound anywhere in the subtree */
 
   int refcount;
   struct TickitBindings bindings;
 };
 
+/* An optional index of a window's children by the rows of the window they
+ * cover, so that finding the children at a point or within a rect doesn't
+ * need to walk all of them. Each row lists the children covering it in
+ * stacking order. It is rebuilt lazily after any change to the children.
+ */
+typedef struct {
+  TickitWindow **wins;
+  int n, size;
+} ChildRow;
+
+struct ChildIndex {
+  bool dirty;
+  int lines;
+  ChildRow *rows;
+  ChildRow steal; /* children with steal_input, which see every mouse event */
+  ChildRow scratch; /* lent out by _indexed_children(); empty while on loan */
+};
+
+/* A key event, reduced to the form key bindings are stored by */
+struct KeyLookup {
+  const char *name; /* without any modifier prefixes */
+  int mod;
+  unsigned int hash;
+  uint64_t bloom;
+};
+
 #define WINDOW_PRINTF_FMT     "[%dx%d abs@%d,%d]"
 #define WINDOW_PRINTF_ARGS(w) (w)->rect.cols, (w)->rect.lines, tickit_window_get_abs_geometry(w).left, tickit_window_get_abs_geometry(w).top
 
 #define RECT_PRINTF_FMT     "[(%d,%d)..(%d,%d)]"
 #define RECT_PRINTF_ARGS(r) (r).left, (r).top, tickit_rect_right(&(r)), tickit_rect_bottom(&(r))
 
-DEFINE_BINDINGS_FUNCS(window,TickitWindow,TickitWindowEventFn)
+DEFINE_BINDINGS_RUN_FUNCS(TickitWindow)
 
 typedef struct HierarchyChange HierarchyChange;
 struct HierarchyChange {
@@ -73,10 +120,26 @@ struct TickitRootWindow {
   bool needs_expose;
   bool needs_restore;
   bool needs_later_processing;
+  bool flush_scheduled;
+
+  /* Damage simplification policy; see _simplify_damage() */
+  int damage_merge_rects;
+  int damage_expose_cost;
+
+  /* Flushes wait for pending terminal input, for at most this long */
+  int input_defer_msec;
+  bool flush_deferred;
+  struct timeval flush_deferred_since;
+
+  /* Reused by _do_expose() for each window's visible region, one per depth
+   * of the tree, so that exposing doesn't allocate anything per window
+   */
+  TickitRectSet **expose_visible;
+  int expose_visible_depth;
 
   Tickit *tickit; /* uncounted */
 
-  int event_ids[3];
+  int event_ids[4];
 
   // Drag/drop context handling
   bool mouse_dragging;
@@ -91,9 +154,26 @@ static void _request_later_processing(TickitRootWindow *root);
 static void _request_hierarchy_change(HierarchyChangeType, TickitWindow *);
 static void _do_hierarchy_change(HierarchyChangeType change, TickitWindow *parent, TickitWindow *win);
 static void _purge_hierarchy_changes(TickitWindow *win);
-static int _handle_key(TickitWindow *win, TickitKeyEventInfo *args);
+static void _damage(TickitWindow *win, const TickitRect *exposed);
+static void _make_key_lookup(KeyLookup *key, const TickitKeyEventInfo *info);
+static bool _keys_may_handle(TickitWindow *win, const KeyLookup *key);
+static int _run_keymap(TickitWindow *win, TickitKeyEventInfo *info, const KeyLookup *key);
+static void _invalidate_key_summary(TickitWindow *win);
+static void _destroy_keymap(TickitWindow *win);
+static int _handle_key(TickitWindow *win, TickitKeyEventInfo *args, const KeyLookup *key);
 static TickitWindow *_handle_mouse(TickitWindow *win, TickitMouseEventInfo *args);
 
+static int on_term_capschange(TickitTerm *term, TickitEventFlags flags, void *_info, void *user)
+{
+  TickitRootWindow *root = user;
+
+  DEBUG_LOGF("Ic", "Terminal capabilities changed");
+
+  /* Redraw everything now that it can be drawn better */
+  tickit_window_expose(ROOT_AS_WINDOW(root), NULL);
+  return 0;
+}
+
 static int on_term_resize(TickitTerm *term, TickitEventFlags flags, void *_info, void *user)
 {
   TickitRootWindow *root = user;
@@ -136,12 +216,15 @@ static int on_term_key(TickitTerm *term, TickitEventFlags flags, void *_info, vo
   TickitWindow *win = ROOT_AS_WINDOW(root);
 
   TickitKeyEventInfo *info = _info;
-  static const char * const evnames[] = { NULL, "KEY", "TEXT" };
+  static const char * const evnames[] = { NULL, "KEY", "TEXT", "PASTE" };
 
   DEBUG_LOGF("Ik", "Key event %s %s (mod=%02x)",
-      evnames[info->type], info->str, info->mod);
+      evnames[info->type], info->type == TICKIT_KEYEV_PASTE ? "..." : info->str, info->mod);
+
+  KeyLookup key;
+  _make_key_lookup(&key, info);
 
-  return _handle_key(win, info);
+  return _handle_key(win, info, &key);
 }
 
 static int on_term_mouse(TickitTerm *term, TickitEventFlags flags, void *_info, void *user)
@@ -216,6 +299,20 @@ static int on_term_mouse(TickitTerm *term, TickitEventFlags flags, void *_info,
   return !!handled;
 }
 
+/* Absolute geometry is cached on first use. A window's cache can only be
+ * valid if its parent's is, so invalidation can stop at the first window
+ * that doesn't hold one.
+ */
+static void _invalidate_abs_geometry(TickitWindow *win)
+{
+  if(!win->abs_valid)
+    return;
+
+  win->abs_valid = false;
+  for(TickitWindow *child = win->first_child; child; child = child->next)
+    _invalidate_abs_geometry(child);
+}
+
 static void init_window(TickitWindow *win, TickitWindow *parent, TickitRect rect)
 {
   win->parent = parent;
@@ -235,6 +332,18 @@ static void init_window(TickitWindow *win, TickitWindow *parent, TickitRect rect
   win->is_closed = false;
   win->steal_input = false;
   win->focus_child_notify = false;
+  win->abs_valid = false;
+  win->keys_valid = false;
+  win->keys_any = false;
+
+  win->child_index = NULL;
+  win->zorder = 0;
+
+  win->cache = NULL;
+  win->cache_dirty = NULL;
+
+  win->keymap = NULL;
+  win->keys_bloom = 0;
 
   win->refcount = 1;
   win->bindings = (struct TickitBindings){ NULL };
@@ -258,6 +367,13 @@ TickitWindow* tickit_window_new_root2(Tickit *t, TickitTerm *term)
   root->needs_expose = false;
   root->needs_restore = false;
   root->needs_later_processing = false;
+  root->flush_scheduled = false;
+  root->damage_merge_rects = 16;
+  root->damage_expose_cost = 80;
+  root->input_defer_msec = 16;
+  root->flush_deferred = false;
+  root->expose_visible = NULL;
+  root->expose_visible_depth = 0;
   root->tickit = t; /* uncounted */
 
   root->damage = tickit_rectset_new();
@@ -272,6 +388,8 @@ TickitWindow* tickit_window_new_root2(Tickit *t, TickitTerm *term)
       &on_term_key, root);
   root->event_ids[2] = tickit_term_bind_event(term, TICKIT_TERM_ON_MOUSE, 0,
       &on_term_mouse, root);
+  root->event_ids[3] = tickit_term_bind_event(term, TICKIT_TERM_ON_CAPSCHANGE, 0,
+      &on_term_capschange, root);
 
   root->mouse_dragging = false;
 
@@ -298,6 +416,641 @@ static TickitRootWindow *_get_root(const TickitWindow *win)
   return WINDOW_AS_ROOT(win);
 }
 
+static bool _childrow_push(ChildRow *row, TickitWindow *win)
+{
+  if(row->n == row->size) {
+    int size = row->size ? row->size * 2 : 4;
+    TickitWindow **wins = realloc(row->wins, size * sizeof(TickitWindow *));
+    if(!wins)
+      return false;
+    row->wins = wins;
+    row->size = size;
+  }
+  row->wins[row->n++] = win;
+  return true;
+}
+
+static void _destroy_child_index(ChildIndex *index)
+{
+  for(int line = 0; line < index->lines; line++)
+    free(index->rows[line].wins);
+  free(index->rows);
+  free(index->steal.wins);
+  free(index->scratch.wins);
+  free(index);
+}
+
+static void _invalidate_child_index(TickitWindow *win)
+{
+  if(win && win->child_index)
+    win->child_index->dirty = true;
+}
+
+/* Returns NULL if the window isn't indexed, or if the index can't be rebuilt
+ * for lack of memory; it stays dirty, to be tried again next time
+ */
+static ChildIndex *_get_child_index(TickitWindow *win)
+{
+  ChildIndex *index = win->child_index;
+  if(!index || !index->dirty)
+    return index;
+
+  if(win->rect.lines > index->lines) {
+    ChildRow *rows = realloc(index->rows, win->rect.lines * sizeof(ChildRow));
+    if(!rows)
+      return NULL;
+    index->rows = rows;
+    for(int line = index->lines; line < win->rect.lines; line++)
+      index->rows[line] = (ChildRow){ NULL };
+  }
+  else
+    /* Shrinking just leaves the spare rows allocated */
+    for(int line = win->rect.lines; line < index->lines; line++)
+      free(index->rows[line].wins);
+  index->lines = win->rect.lines;
+
+  for(int line = 0; line < index->lines; line++)
+    index->rows[line].n = 0;
+  index->steal.n = 0;
+
+  int zorder = 0;
+  for(TickitWindow *child = win->first_child; child; child = child->next) {
+    child->zorder = zorder++;
+
+    if(child->steal_input && !_childrow_push(&index->steal, child))
+      return NULL;
+
+    int top    = child->rect.top < 0 ? 0 : child->rect.top;
+    int bottom = tickit_rect_bottom(&child->rect);
+    if(bottom > index->lines)
+      bottom = index->lines;
+
+    for(int line = top; line < bottom; line++)
+      if(!_childrow_push(&index->rows[line], child))
+        return NULL;
+  }
+
+  index->dirty = false;
+  return index;
+}
+
+/* Rows outside the window aren't indexed, so queries there must fall back to
+ * walking every child
+ */
+static ChildIndex *_get_child_index_covering(TickitWindow *win, const TickitRect *rect)
+{
+  ChildIndex *index = _get_child_index(win);
+  if(index && (rect->top < 0 || tickit_rect_bottom(rect) > index->lines))
+    return NULL;
+
+  return index;
+}
+
+static int _cmp_zorder(const void *a, const void *b)
+{
+  return (*(TickitWindow * const *)a)->zorder - (*(TickitWindow * const *)b)->zorder;
+}
+
+/* Collects the children whose geometry intersects rect into *out in stacking
+ * order. If steal is set, children with steal_input are included regardless.
+ * The array is the index's scratch one if that isn't already lent out, and
+ * must be handed back with _release_indexed(). Returns false if it can't be
+ * allocated, in which case the caller should walk the children instead.
+ */
+static bool _indexed_children(ChildIndex *index, const TickitRect *rect, bool steal, ChildRow *out)
+{
+  int top    = rect->top < 0 ? 0 : rect->top;
+  int bottom = tickit_rect_bottom(rect);
+  if(bottom > index->lines)
+    bottom = index->lines;
+
+  int n = 0, size = steal ? index->steal.n : 0;
+  for(int line = top; line < bottom; line++)
+    size += index->rows[line].n;
+
+  *out = index->scratch;
+  index->scratch = (ChildRow){ NULL };
+
+  if(out->size < size || !out->wins) {
+    int newsize = size ? size : 1;
+    TickitWindow **newwins = realloc(out->wins, newsize * sizeof(TickitWindow *));
+    if(!newwins) {
+      index->scratch = *out;
+      return false;
+    }
+    out->wins = newwins;
+    out->size = newsize;
+  }
+
+  TickitWindow **wins = out->wins;
+
+  for(int line = top; line < bottom; line++) {
+    ChildRow *row = &index->rows[line];
+    for(int i = 0; i < row->n; i++) {
+      TickitWindow *child = row->wins[i];
+      /* Only take each child from the first row it shares with rect */
+      if(child->rect.top > top && child->rect.top != line)
+        continue;
+      if(child->rect.top <= top && line != top)
+        continue;
+      if(child->rect.left >= tickit_rect_right(rect) ||
+         tickit_rect_right(&child->rect) <= rect->left)
+        continue;
+
+      wins[n++] = child;
+    }
+  }
+
+  int n_intersecting = n;
+  if(steal)
+    for(int i = 0; i < index->steal.n; i++) {
+      TickitWindow *child = index->steal.wins[i];
+      int j;
+      for(j = 0; j < n_intersecting; j++)
+        if(wins[j] == child)
+          break;
+      if(j == n_intersecting)
+        wins[n++] = child;
+    }
+
+  qsort(wins, n, sizeof(TickitWindow *), &_cmp_zorder);
+
+  out->n = n;
+  return true;
+}
+
+/* Gives the array back to win's index for reuse, if it still has one */
+static void _release_indexed(TickitWindow *win, ChildRow *row)
+{
+  ChildIndex *index = win->child_index;
+  if(index && !index->scratch.wins)
+    index->scratch = *row;
+  else
+    free(row->wins);
+
+  *row = (ChildRow){ NULL };
+}
+
+static bool _create_cache(TickitWindow *win)
+{
+  win->cache = tickit_renderbuffer_new(win->rect.lines, win->rect.cols);
+  win->cache_dirty = tickit_rectset_new();
+  if(!win->cache || !win->cache_dirty) {
+    if(win->cache)
+      tickit_renderbuffer_unref(win->cache);
+    if(win->cache_dirty)
+      tickit_rectset_destroy(win->cache_dirty);
+    win->cache = NULL;
+    win->cache_dirty = NULL;
+    return false;
+  }
+
+  tickit_rectset_add(win->cache_dirty,
+      &(TickitRect){ .top = 0, .left = 0, .lines = win->rect.lines, .cols = win->rect.cols });
+  return true;
+}
+
+static void _destroy_cache(TickitWindow *win)
+{
+  if(!win->cache)
+    return;
+
+  tickit_renderbuffer_unref(win->cache);
+  tickit_rectset_destroy(win->cache_dirty);
+  win->cache = NULL;
+  win->cache_dirty = NULL;
+}
+
+/* Re-render just the parts of rect that the window has exposed since they
+ * were last cached. The whole area is rendered, including any parts hidden
+ * by children, so the cache can later stand in for all of it.
+ */
+static void _update_cache(TickitWindow *win, const TickitRect *rect, TickitRectSet *visible)
+{
+  if(!visible || !tickit_rectset_intersects(win->cache_dirty, rect))
+    return;
+
+  int n = tickit_rectset_rects(win->cache_dirty);
+  TickitRect *dirty = malloc(n * sizeof(TickitRect));
+  if(!dirty)
+    /* Leave it all dirty so a later flush can try again */
+    return;
+
+  /* Take the dirty parts of rect before rendering them, so that anything an
+   * expose handler itself marks dirty in there stays dirty for next time
+   */
+  tickit_rectset_get_rects(win->cache_dirty, dirty, n);
+  int n_exposed = 0;
+  for(int i = 0; i < n; i++)
+    if(tickit_rect_intersect(&dirty[n_exposed], &dirty[i], rect))
+      n_exposed++;
+
+  tickit_rectset_subtract(win->cache_dirty, rect);
+
+  for(int i = 0; i < n_exposed; i++) {
+    TickitRect exposed = dirty[i];
+
+    tickit_renderbuffer_save(win->cache);
+
+    tickit_renderbuffer_clip(win->cache, &exposed);
+    tickit_renderbuffer_skiprect(win->cache, &exposed);
+    if(win->pen)
+      tickit_renderbuffer_setpen(win->cache, win->pen);
+
+    tickit_rectset_clear(visible);
+    tickit_rectset_add(visible, &exposed);
+
+    TickitExposeEventInfo info = {
+      .rect = exposed,
+      .rb = win->cache,
+      .visible = visible,
+    };
+    run_events(win, TICKIT_WINDOW_ON_EXPOSE, &info);
+
+    tickit_renderbuffer_restore(win->cache);
+  }
+
+  free(dirty);
+}
+
+/* The cached rendering scrolls along with the window; whatever scrolls into
+ * view needs rendering afresh, even if it isn't currently visible
+ */
+static void _scroll_cache(TickitWindow *win, const TickitRect *rect, int downward, int rightward)
+{
+  tickit_rectset_translate_within(win->cache_dirty, rect, -downward, -rightward);
+
+  TickitRect dest = *rect;
+  tickit_rect_translate(&dest, -downward, -rightward);
+
+  if(!tickit_rect_intersect(&dest, &dest, rect)) {
+    tickit_rectset_add(win->cache_dirty, rect);
+    return;
+  }
+
+  TickitRect src = dest;
+  tickit_rect_translate(&src, downward, rightward);
+  tickit_renderbuffer_moverect(win->cache, &dest, &src);
+
+  TickitRect revealed[4];
+  int n = tickit_rect_subtract(revealed, rect, &dest);
+  for(int i = 0; i < n; i++)
+    tickit_rectset_add(win->cache_dirty, &revealed[i]);
+}
+
+/* Key bindings are hashed by key name and modifiers. Each window also keeps
+ * a summary of its whole subtree: whether any window in it has a generic
+ * TICKIT_WINDOW_ON_KEY handler, and a bloom filter of the keys bound in it.
+ * Key events skip any subtree whose summary rules them out.
+ */
+typedef struct KeyBinding KeyBinding;
+struct KeyBinding {
+  KeyBinding *next;
+  KeyBinding *id_next; /* within its bucket of byid, until unbound */
+  int id;
+  int mod;
+  unsigned int hash;
+  TickitBindFlags flags;
+  TickitWindowEventFn *fn; /* NULL once unbound while iterating */
+  void *user;
+  char name[];
+};
+
+struct KeyMap {
+  KeyBinding **buckets;
+  KeyBinding **byid; /* hashed by ID; shares the allocation of buckets */
+  int n_buckets, count;
+  int next_id;
+  int iterating;
+  bool needs_delete;
+  uint64_t bloom;
+  unsigned int bloom_counts[64]; /* bound keys setting each bit of bloom */
+};
+
+static unsigned int _key_hash(const char *name, int mod)
+{
+  /* FNV-1a */
+  unsigned int hash = 2166136261u;
+  for(; *name; name++)
+    hash = (hash ^ (unsigned char)*name) * 16777619u;
+
+  return (hash ^ mod) * 16777619u;
+}
+
+static uint64_t _key_bloom(unsigned int hash)
+{
+  return (UINT64_C(1) << (hash & 63)) | (UINT64_C(1) << ((hash >> 6) & 63));
+}
+
+static void _make_key_lookup(KeyLookup *key, const TickitKeyEventInfo *info)
+{
+  if(info->type == TICKIT_KEYEV_PASTE) {
+    /* No key binding can match pasted text */
+    *key = (KeyLookup){ .name = NULL };
+    return;
+  }
+
+  const char *name = info->str;
+
+  /* Key events name their modifiers as "M-", "C-" and "S-" prefixes, one
+   * for each bit of mod
+   */
+  if(info->type == TICKIT_KEYEV_KEY)
+    for(int mod = info->mod; mod; mod &= mod - 1)
+      if(name[0] && name[1] == '-')
+        name += 2;
+
+  key->name  = name;
+  key->mod   = info->mod;
+  key->hash  = _key_hash(name, info->mod);
+  key->bloom = _key_bloom(key->hash);
+}
+
+static void _invalidate_key_summary(TickitWindow *win)
+{
+  for(; win && win->keys_valid; win = win->parent)
+    win->keys_valid = false;
+}
+
+static void _update_key_summary(TickitWindow *win)
+{
+  if(win->keys_valid)
+    return;
+
+  bool any = tickit_bindings_has_event(&win->bindings, TICKIT_WINDOW_ON_KEY);
+  uint64_t bloom = win->keymap ? win->keymap->bloom : 0;
+
+  for(TickitWindow *child = win->first_child; child; child = child->next) {
+    _update_key_summary(child);
+    any   |= child->keys_any;
+    bloom |= child->keys_bloom;
+  }
+
+  win->keys_any   = any;
+  win->keys_bloom = bloom;
+  win->keys_valid = true;
+}
+
+static bool _keys_may_handle(TickitWindow *win, const KeyLookup *key)
+{
+  _update_key_summary(win);
+  return win->keys_any || (key->name && (win->keys_bloom & key->bloom) == key->bloom);
+}
+
+/* Counting each bit lets a binding leave the filter without rebuilding it */
+static void _count_key_bloom(KeyMap *keymap, unsigned int hash, int delta)
+{
+  int bits[2] = { hash & 63, (hash >> 6) & 63 };
+  for(int i = 0; i < 2; i++) {
+    if((keymap->bloom_counts[bits[i]] += delta))
+      keymap->bloom |= UINT64_C(1) << bits[i];
+    else
+      keymap->bloom &= ~(UINT64_C(1) << bits[i]);
+  }
+}
+
+static void _unlink_keybinding_id(KeyMap *keymap, KeyBinding *kb)
+{
+  KeyBinding **kbp = &keymap->byid[kb->id & (keymap->n_buckets - 1)];
+  while(*kbp != kb)
+    kbp = &(*kbp)->id_next;
+  *kbp = kb->id_next;
+}
+
+static void _cleanup_keymap(KeyMap *keymap)
+{
+  for(int i = 0; i < keymap->n_buckets; i++)
+    for(KeyBinding **kbp = &keymap->buckets[i]; *kbp; /**/) {
+      KeyBinding *kb = *kbp;
+      if(kb->fn) {
+        kbp = &kb->next;
+        continue;
+      }
+
+      *kbp = kb->next;
+      free(kb);
+    }
+
+  keymap->needs_delete = false;
+}
+
+static void _kill_keybinding(KeyMap *keymap, KeyBinding *kb)
+{
+  _unlink_keybinding_id(keymap, kb);
+  _count_key_bloom(keymap, kb->hash, -1);
+
+  kb->fn = NULL;
+  keymap->count--;
+  keymap->needs_delete = true;
+}
+
+static int _run_keymap(TickitWindow *win, TickitKeyEventInfo *info, const KeyLookup *key)
+{
+  KeyMap *keymap = win->keymap;
+  if(!key->name || !keymap->count || !(keymap->bloom & key->bloom))
+    return 0;
+
+  int ret = 0;
+  keymap->iterating++;
+
+  for(KeyBinding *kb = keymap->buckets[key->hash & (keymap->n_buckets - 1)]; kb; kb = kb->next) {
+    if(!kb->fn || kb->hash != key->hash || kb->mod != key->mod || !streq(kb->name, key->name))
+      continue;
+
+    TickitWindowEventFn *fn = kb->fn;
+    TickitEventFlags flags = TICKIT_EV_FIRE;
+    if(kb->flags & TICKIT_BIND_ONESHOT) {
+      flags |= TICKIT_EV_UNBIND;
+      _kill_keybinding(keymap, kb);
+    }
+
+    if((ret = (*fn)(win, flags, info, kb->user)))
+      break;
+  }
+
+  if(!--keymap->iterating && keymap->needs_delete) {
+    _cleanup_keymap(keymap);
+    _invalidate_key_summary(win);
+  }
+
+  return ret;
+}
+
+static void _destroy_keymap(TickitWindow *win)
+{
+  KeyMap *keymap = win->keymap;
+  if(!keymap)
+    return;
+
+  for(int i = 0; i < keymap->n_buckets; i++)
+    for(KeyBinding *kb = keymap->buckets[i]; kb; /**/) {
+      KeyBinding *next = kb->next;
+      if(kb->fn && kb->flags & (TICKIT_BIND_UNBIND|TICKIT_BIND_DESTROY))
+        (*kb->fn)(win, TICKIT_EV_UNBIND|TICKIT_EV_DESTROY, NULL, kb->user);
+      free(kb);
+      kb = next;
+    }
+
+  free(keymap->buckets);
+  free(keymap);
+  win->keymap = NULL;
+}
+
+/* If there's no memory to grow into, the chains just get longer */
+static void _grow_keymap(KeyMap *keymap)
+{
+  int n_buckets = keymap->n_buckets * 2;
+  KeyBinding **buckets = calloc(2 * n_buckets, sizeof(KeyBinding *));
+  if(!buckets)
+    return;
+
+  KeyBinding **byid = buckets + n_buckets;
+
+  /* Rehashing in reverse keeps each bucket in binding order */
+  for(int i = keymap->n_buckets - 1; i >= 0; i--) {
+    KeyBinding *rev = NULL;
+    for(KeyBinding *kb = keymap->buckets[i]; kb; /**/) {
+      KeyBinding *next = kb->next;
+      kb->next = rev;
+      rev = kb;
+      kb = next;
+    }
+
+    for(KeyBinding *kb = rev; kb; /**/) {
+      KeyBinding *next = kb->next;
+      KeyBinding **headp = &buckets[kb->hash & (n_buckets - 1)];
+      kb->next = *headp;
+      *headp = kb;
+      kb = next;
+    }
+  }
+
+  for(int i = 0; i < keymap->n_buckets; i++)
+    for(KeyBinding *kb = keymap->byid[i]; kb; /**/) {
+      KeyBinding *next = kb->id_next;
+      KeyBinding **headp = &byid[kb->id & (n_buckets - 1)];
+      kb->id_next = *headp;
+      *headp = kb;
+      kb = next;
+    }
+
+  free(keymap->buckets);
+  keymap->buckets = buckets;
+  keymap->byid = byid;
+  keymap->n_buckets = n_buckets;
+}
+
+int tickit_window_bind_key(TickitWindow *win, const char *key, int mod, TickitBindFlags flags,
+    TickitWindowEventFn *fn, void *user)
+{
+  KeyMap *keymap = win->keymap;
+  if(!keymap) {
+    keymap = malloc(sizeof(KeyMap));
+    if(!keymap)
+      return -1;
+
+    *keymap = (KeyMap){ .n_buckets = 8 };
+    keymap->buckets = calloc(2 * keymap->n_buckets, sizeof(KeyBinding *));
+    if(!keymap->buckets) {
+      free(keymap);
+      return -1;
+    }
+    keymap->byid = keymap->buckets + keymap->n_buckets;
+
+    win->keymap = keymap;
+  }
+
+  /* Buckets can't be rearranged under a running dispatch */
+  if(!keymap->iterating && keymap->count >= keymap->n_buckets)
+    _grow_keymap(keymap);
+
+  size_t len = strlen(key);
+  KeyBinding *kb = malloc(sizeof(KeyBinding) + len + 1);
+  if(!kb)
+    return -1;
+
+  kb->id    = ++keymap->next_id;
+  kb->mod   = mod;
+  kb->hash  = _key_hash(key, mod);
+  kb->flags = flags & (TICKIT_BIND_UNBIND|TICKIT_BIND_DESTROY|TICKIT_BIND_ONESHOT);
+  kb->fn    = fn;
+  kb->user  = user;
+  memcpy(kb->name, key, len + 1);
+
+  KeyBinding **kbp = &keymap->buckets[kb->hash & (keymap->n_buckets - 1)];
+  if(!(flags & TICKIT_BIND_FIRST))
+    while(*kbp)
+      kbp = &(*kbp)->next;
+
+  kb->next = *kbp;
+  *kbp = kb;
+
+  KeyBinding **headp = &keymap->byid[kb->id & (keymap->n_buckets - 1)];
+  kb->id_next = *headp;
+  *headp = kb;
+
+  keymap->count++;
+  _count_key_bloom(keymap, kb->hash, +1);
+  _invalidate_key_summary(win);
+
+  return kb->id;
+}
+
+void tickit_window_unbind_key_id(TickitWindow *win, int id)
+{
+  KeyMap *keymap = win->keymap;
+  if(!keymap)
+    return;
+
+  /* Only live bindings are kept in byid */
+  KeyBinding *kb = keymap->byid[id & (keymap->n_buckets - 1)];
+  while(kb && kb->id != id)
+    kb = kb->id_next;
+  if(!kb)
+    return;
+
+  TickitWindowEventFn *fn = kb->fn;
+  void *user = kb->user;
+  bool notify = kb->flags & TICKIT_BIND_UNBIND;
+
+  if(keymap->iterating)
+    _kill_keybinding(keymap, kb);
+  else {
+    _unlink_keybinding_id(keymap, kb);
+    _count_key_bloom(keymap, kb->hash, -1);
+
+    KeyBinding **kbp = &keymap->buckets[kb->hash & (keymap->n_buckets - 1)];
+    while(*kbp != kb)
+      kbp = &(*kbp)->next;
+    *kbp = kb->next;
+
+    free(kb);
+    keymap->count--;
+  }
+
+  _invalidate_key_summary(win);
+
+  if(notify)
+    (*fn)(win, TICKIT_EV_UNBIND, NULL, user);
+}
+
+int tickit_window_bind_event(TickitWindow *win, TickitWindowEvent ev, TickitBindFlags flags,
+    TickitWindowEventFn *fn, void *user)
+{
+  if(ev == TICKIT_WINDOW_ON_KEY)
+    _invalidate_key_summary(win);
+
+  return tickit_bindings_bind_event(&win->bindings, win, ev, flags, (TickitEventFn*)fn, user);
+}
+
+void tickit_window_unbind_event_id(TickitWindow *win, int id)
+{
+  tickit_bindings_unbind_event_id(&win->bindings, win, id);
+
+  /* This may have been the subtree's last key handler */
+  _invalidate_key_summary(win);
+}
+
 TickitWindow *tickit_window_new(TickitWindow *parent, TickitRect rect, TickitWindowFlags flags)
 {
   if(flags & TICKIT_WINDOW_ROOT_PARENT)
@@ -376,9 +1129,18 @@ void tickit_window_destroy(TickitWindow *win)
   if(win->pen)
     tickit_pen_unref(win->pen);
 
+  if(win->child_index) {
+    _destroy_child_index(win->child_index);
+    win->child_index = NULL;
+  }
+
+  _destroy_cache(win);
+  _destroy_keymap(win);
+
   for(TickitWindow *child = win->first_child; child; /**/) {
     TickitWindow *next = child->next;
 
+    _invalidate_abs_geometry(child);
     tickit_window_unref(child);
     child->parent = NULL;
     child = next;
@@ -397,9 +1159,14 @@ void tickit_window_destroy(TickitWindow *win)
       tickit_rectset_destroy(root->damage);
     }
 
+    for(int depth = 0; depth < root->expose_visible_depth; depth++)
+      tickit_rectset_destroy(root->expose_visible[depth]);
+    free(root->expose_visible);
+
     tickit_term_unbind_event_id(root->term, root->event_ids[0]);
     tickit_term_unbind_event_id(root->term, root->event_ids[1]);
     tickit_term_unbind_event_id(root->term, root->event_ids[2]);
+    tickit_term_unbind_event_id(root->term, root->event_ids[3]);
 
     tickit_term_unref(root->term);
   }
@@ -456,7 +1223,7 @@ void tickit_window_show(TickitWindow *win)
       win->parent->focused_child = win;
     }
   }
-  tickit_window_expose(win, NULL);
+  _damage(win, NULL);
 }
 
 void tickit_window_hide(TickitWindow *win)
@@ -468,7 +1235,7 @@ void tickit_window_hide(TickitWindow *win)
     if(parent->focused_child && (parent->focused_child == win)) {
       parent->focused_child = NULL;
     }
-    tickit_window_expose(parent, &win->rect);
+    _damage(parent, &win->rect);
   }
 }
 
@@ -482,14 +1249,24 @@ TickitRect tickit_window_get_geometry(const TickitWindow *win)
   return win->rect;
 }
 
-TickitRect tickit_window_get_abs_geometry(const TickitWindow *win)
+static const TickitRect *_get_abs_rect(TickitWindow *win)
 {
-  TickitRect geom = win->rect;
+  if(!win->abs_valid) {
+    win->abs_rect = win->rect;
+    if(win->parent) {
+      const TickitRect *parent_rect = _get_abs_rect(win->parent);
+      tickit_rect_translate(&win->abs_rect, parent_rect->top, parent_rect->left);
+    }
+    win->abs_valid = true;
+  }
 
-  for(win = win->parent; win; win = win->parent)
-    tickit_rect_translate(&geom, win->rect.top, win->rect.left);
+  return &win->abs_rect;
+}
 
-  return geom;
+TickitRect tickit_window_get_abs_geometry(const TickitWindow *win)
+{
+  /* The cached value is not part of the window's observable state */
+  return *_get_abs_rect((TickitWindow *)win);
 }
 
 int tickit_window_bottom(const TickitWindow *win)
@@ -539,6 +1316,23 @@ void tickit_window_set_geometry(TickitWindow *win, TickitRect geom)
 
     win->rect = geom;
 
+    /* Only a move changes the absolute position of the window's descendants */
+    if(geom.top != info.oldrect.top || geom.left != info.oldrect.left)
+      _invalidate_abs_geometry(win);
+    else {
+      win->abs_rect.lines = geom.lines;
+      win->abs_rect.cols  = geom.cols;
+    }
+    _invalidate_child_index(win->parent);
+    if(geom.lines != info.oldrect.lines)
+      _invalidate_child_index(win);
+
+    if(win->cache &&
+       (geom.lines != info.oldrect.lines || geom.cols != info.oldrect.cols)) {
+      _destroy_cache(win);
+      _create_cache(win);
+    }
+
     run_events(win, TICKIT_WINDOW_ON_GEOMCHANGE, &info);
   }
 }
@@ -557,9 +1351,34 @@ void tickit_window_set_pen(TickitWindow *win, TickitPen *pen)
     win->pen = tickit_pen_ref(pen);
   else
     win->pen = NULL;
+
+  if(win->cache)
+    tickit_rectset_add(win->cache_dirty,
+        &(TickitRect){ .top = 0, .left = 0, .lines = win->rect.lines, .cols = win->rect.cols });
 }
 
+/* The window's own content has changed, so any cached rendering of it is
+ * stale as well as the area of the screen it covers
+ */
 void tickit_window_expose(TickitWindow *win, const TickitRect *exposed)
+{
+  if(win->cache) {
+    TickitRect selfrect = { .top = 0, .left = 0, .lines = win->rect.lines, .cols = win->rect.cols };
+    TickitRect dirty;
+
+    if(!exposed)
+      dirty = selfrect;
+    else if(!tickit_rect_intersect(&dirty, &selfrect, exposed))
+      return;
+
+    tickit_rectset_add(win->cache_dirty, &dirty);
+  }
+
+  _damage(win, exposed);
+}
+
+/* Only the screen area needs redrawing; the window's content is unchanged */
+static void _damage(TickitWindow *win, const TickitRect *exposed)
 {
   TickitRect selfrect = { .top = 0, .left = 0, .lines = win->rect.lines, .cols = win->rect.cols };
   TickitRect damaged;
@@ -580,7 +1399,7 @@ void tickit_window_expose(TickitWindow *win, const TickitRect *exposed)
       return;
 
     tickit_rect_translate(&damaged, win->rect.top, win->rect.left);
-    tickit_window_expose(win->parent, &damaged);
+    _damage(win->parent, &damaged);
     return;
   }
 
@@ -598,6 +1417,73 @@ void tickit_window_expose(TickitWindow *win, const TickitRect *exposed)
   _request_later_processing(root);
 }
 
+/* Each separate damage rect costs a whole tree walk in _do_expose(), plus a
+ * save/clip/restore of the renderbuffer. Once the damage is fragmented into
+ * enough rects, estimate that overhead as damage_expose_cost cells each and
+ * replace any run of vertically-touching rects by their bounding box, or the
+ * whole lot by one bounding box, wherever that is estimated to be cheaper.
+ * Returns the new count of rects.
+ */
+static int _simplify_damage(TickitRootWindow *root, TickitRect *rects, int n)
+{
+  if(!root->damage_merge_rects || n < root->damage_merge_rects)
+    return n;
+
+  long expose_cost = root->damage_expose_cost;
+
+  TickitRect all = rects[0];
+  long cost = 0;
+  int out = 0;
+
+  // Damage rects are sorted by top, so each run is contiguous
+  for(int i = 0; i < n; /**/) {
+    TickitRect bbox = rects[i];
+    long area = 0;
+
+    int j;
+    for(j = i; j < n && rects[j].top <= tickit_rect_bottom(&bbox); j++) {
+      TickitRect *r = &rects[j];
+      tickit_rect_init_bounded(&bbox,
+          bbox.top,
+          r->left < bbox.left ? r->left : bbox.left,
+          tickit_rect_bottom(r) > tickit_rect_bottom(&bbox) ? tickit_rect_bottom(r) : tickit_rect_bottom(&bbox),
+          tickit_rect_right(r) > tickit_rect_right(&bbox) ? tickit_rect_right(r) : tickit_rect_right(&bbox));
+      area += (long)r->lines * r->cols;
+    }
+
+    long fragmented = (j - i) * expose_cost + area;
+    long merged     = expose_cost + (long)bbox.lines * bbox.cols;
+
+    if(merged < fragmented) {
+      rects[out++] = bbox;
+      cost += merged;
+    }
+    else {
+      memmove(rects + out, rects + i, (j - i) * sizeof(rects[0]));
+      out += j - i;
+      cost += fragmented;
+    }
+
+    tickit_rect_init_bounded(&all,
+        all.top,
+        bbox.left < all.left ? bbox.left : all.left,
+        tickit_rect_bottom(&bbox),
+        tickit_rect_right(&bbox) > tickit_rect_right(&all) ? tickit_rect_right(&bbox) : tickit_rect_right(&all));
+
+    i = j;
+  }
+
+  if(expose_cost + (long)all.lines * all.cols < cost) {
+    rects[0] = all;
+    out = 1;
+  }
+
+  if(out < n)
+    DEBUG_LOGF("Wd", "Simplified %d damage rects to %d", n, out);
+
+  return out;
+}
+
 static char *_gen_indent(TickitWindow *win)
 {
   int depth = 0;
@@ -622,7 +1508,26 @@ static char *_gen_indent(TickitWindow *win)
   return buf;
 }
 
-static void _do_expose(TickitWindow *win, const TickitRect *rect, TickitRenderBuffer *rb)
+static TickitRectSet *_get_expose_visible(TickitRootWindow *root, int depth)
+{
+  /* The tree is walked one level at a time, so it only ever grows by one */
+  if(depth == root->expose_visible_depth) {
+    TickitRectSet **sets = realloc(root->expose_visible, (depth + 1) * sizeof(TickitRectSet *));
+    if(!sets)
+      return NULL;
+    root->expose_visible = sets;
+
+    if(!(sets[depth] = tickit_rectset_new()))
+      return NULL;
+    root->expose_visible_depth++;
+  }
+
+  TickitRectSet *visible = root->expose_visible[depth];
+  tickit_rectset_clear(visible);
+  return visible;
+}
+
+static void _do_expose(TickitRootWindow *root, TickitWindow *win, const TickitRect *rect, TickitRenderBuffer *rb, int depth)
 {
   DEBUG_LOGF("Wx", "%sExpose " WINDOW_PRINTF_FMT " " RECT_PRINTF_FMT,
       _gen_indent(win), WINDOW_PRINTF_ARGS(win), RECT_PRINTF_ARGS(*rect));
@@ -630,7 +1535,23 @@ static void _do_expose(TickitWindow *win, const TickitRect *rect, TickitRenderBu
   if(win->pen)
     tickit_renderbuffer_setpen(rb, win->pen);
 
-  for(TickitWindow* child = win->first_child; child; child = child->next) {
+  /* The part of rect not covered by any visible child */
+  TickitRectSet *visible = _get_expose_visible(root, depth);
+  if(visible)
+    tickit_rectset_add(visible, rect);
+
+  /* With an index we need only visit the children within rect; masking any
+   * others makes no difference as rb is already clipped to it
+   */
+  ChildRow indexed = { NULL };
+  ChildIndex *index = _get_child_index_covering(win, rect);
+  if(index && !_indexed_children(index, rect, false, &indexed))
+    index = NULL;
+
+  int i = 0;
+  for(TickitWindow* child = index ? (indexed.n ? indexed.wins[0] : NULL) : win->first_child;
+      child;
+      child = index ? (++i < indexed.n ? indexed.wins[i] : NULL) : child->next) {
     if(!child->is_visible)
       continue;
 
@@ -641,19 +1562,36 @@ static void _do_expose(TickitWindow *win, const TickitRect *rect, TickitRenderBu
       tickit_renderbuffer_clip(rb, &exposed);
       tickit_renderbuffer_translate(rb, child->rect.top, child->rect.left);
       tickit_rect_translate(&exposed, -child->rect.top, -child->rect.left);
-      _do_expose(child, &exposed, rb);
+      _do_expose(root, child, &exposed, rb, depth + 1);
 
       tickit_renderbuffer_restore(rb);
     }
 
     tickit_renderbuffer_mask(rb, &child->rect);
+    if(visible)
+      tickit_rectset_subtract(visible, &child->rect);
   }
 
-  TickitExposeEventInfo info = {
-    .rect = *rect,
-    .rb = rb,
-  };
-  run_events(win, TICKIT_WINDOW_ON_EXPOSE, &info);
+  if(index)
+    _release_indexed(win, &indexed);
+
+  /* A window entirely hidden by its children has nothing to draw */
+  if(visible && !tickit_rectset_rects(visible))
+    return;
+
+  if(win->cache) {
+    /* The cache is rendered in full, so this window's set is free for it */
+    _update_cache(win, rect, visible);
+    tickit_renderbuffer_blit(rb, win->cache);
+  }
+  else {
+    TickitExposeEventInfo info = {
+      .rect = *rect,
+      .rb = rb,
+      .visible = visible,
+    };
+    run_events(win, TICKIT_WINDOW_ON_EXPOSE, &info);
+  }
 }
 
 static void _request_restore(TickitRootWindow *root)
@@ -662,9 +1600,52 @@ static void _request_restore(TickitRootWindow *root)
   _request_later_processing(root);
 }
 
+/* Rendering a frame only to have the next keypress invalidate it is wasted
+ * work, so while more terminal input is waiting to be read we put the flush
+ * off until after it, unless that has already taken too long
+ */
+static bool _should_defer_flush(TickitRootWindow *root)
+{
+  if(!root->input_defer_msec || !root->needs_later_processing ||
+     !tickit_term_input_pending(root->term)) {
+    root->flush_deferred = false;
+    return false;
+  }
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  if(!root->flush_deferred) {
+    root->flush_deferred = true;
+    root->flush_deferred_since = now;
+    return true;
+  }
+
+  long waited_msec = (now.tv_sec  - root->flush_deferred_since.tv_sec) * 1000 +
+                     (now.tv_usec - root->flush_deferred_since.tv_usec) / 1000;
+  if(waited_msec < root->input_defer_msec)
+    return true;
+
+  root->flush_deferred = false;
+  return false;
+}
+
 static int _flush_fn(Tickit *t, TickitEventFlags flags, void *info, void *user)
 {
   TickitWindow *win = user;
+  TickitRootWindow *root = WINDOW_AS_ROOT(win);
+
+  root->flush_scheduled = false;
+
+  /* The event loop runs laters before IO watches, so by the time this one
+   * runs again the pending input will have been read
+   */
+  if(_should_defer_flush(root)) {
+    tickit_watch_later(t, 0, _flush_fn, win);
+    root->flush_scheduled = true;
+    return 1;
+  }
+
   tickit_window_flush(win);
   return 1;
 }
@@ -672,8 +1653,10 @@ static int _flush_fn(Tickit *t, TickitEventFlags flags, void *info, void *user)
 static void _request_later_processing(TickitRootWindow *root)
 {
   root->needs_later_processing = true;
-  if(root->tickit)
+  if(root->tickit && !root->flush_scheduled) {
     tickit_watch_later(root->tickit, 0, _flush_fn, ROOT_AS_WINDOW(root));
+    root->flush_scheduled = true;
+  }
 }
 
 static bool _cell_visible(TickitWindow *win, int line, int col)
@@ -684,19 +1667,37 @@ static bool _cell_visible(TickitWindow *win, int line, int col)
        col  < 0 || col  >= win->rect.cols)
       return false;
 
-    for(TickitWindow *child = win->first_child; child; child = child->next) {
-      if(prev && child == prev)
-        break;
-      if(!child->is_visible)
-        continue;
-
-      if(line < child->rect.top  || line >= tickit_rect_bottom(&child->rect))
-        continue;
-      if(col  < child->rect.left || col  >= tickit_rect_right(&child->rect))
-        continue;
-
-      return false;
+    ChildIndex *index = _get_child_index(win);
+    if(index) {
+      /* The row lists exactly the children covering this line, in order */
+      ChildRow *row = &index->rows[line];
+      for(int i = 0; i < row->n; i++) {
+        TickitWindow *child = row->wins[i];
+        if(prev && child->zorder >= prev->zorder)
+          break;
+        if(!child->is_visible)
+          continue;
+
+        if(col  < child->rect.left || col  >= tickit_rect_right(&child->rect))
+          continue;
+
+        return false;
+      }
     }
+    else
+      for(TickitWindow *child = win->first_child; child; child = child->next) {
+        if(prev && child == prev)
+          break;
+        if(!child->is_visible)
+          continue;
+
+        if(line < child->rect.top  || line >= tickit_rect_bottom(&child->rect))
+          continue;
+        if(col  < child->rect.left || col  >= tickit_rect_right(&child->rect))
+          continue;
+
+        return false;
+      }
 
     line += win->rect.top;
     col  += win->rect.left;
@@ -774,11 +1775,13 @@ void tickit_window_flush(TickitWindow *win)
 
     tickit_rectset_clear(root->damage);
 
+    damage_count = _simplify_damage(root, rects, damage_count);
+
     for(int i = 0; i < damage_count; i++) {
       TickitRect *rect = &rects[i];
       tickit_renderbuffer_save(rb);
       tickit_renderbuffer_clip(rb, rect);
-      _do_expose(root_window, rect, rb);
+      _do_expose(root, root_window, rect, rb, 0);
       tickit_renderbuffer_restore(rb);
     }
 
@@ -887,6 +1890,7 @@ static void _do_hierarchy_change(HierarchyChangeType change, TickitWindow *paren
       fmt = "Window " WINDOW_PRINTF_FMT " removes " WINDOW_PRINTF_FMT;
       _do_hierarchy_remove(parent, win);
       win->parent = NULL;
+      _invalidate_abs_geometry(win);
       if(parent->focused_child && parent->focused_child == win)
         parent->focused_child = NULL;
       break;
@@ -910,12 +1914,15 @@ static void _do_hierarchy_change(HierarchyChangeType change, TickitWindow *paren
       break;
   }
 
+  _invalidate_child_index(parent);
+  _invalidate_key_summary(parent);
+
   if(fmt)
     DEBUG_LOGF("Wh", fmt,
         WINDOW_PRINTF_ARGS(parent), WINDOW_PRINTF_ARGS(win));
 
   if(win->is_visible)
-    tickit_window_expose(parent, &win->rect);
+    _damage(parent, &win->rect);
 }
 
 static void _request_hierarchy_change(HierarchyChangeType change, TickitWindow *win)
@@ -979,14 +1986,26 @@ static bool _scrollrectset(TickitWindow *win, TickitRectSet *visible, int downwa
     abs_left += win->rect.left;
     tickit_rectset_translate(visible, win->rect.top, win->rect.left);
 
-    for(TickitWindow *sib = parent->first_child; sib; sib = sib->next) {
-      if(sib == win)
-        break;
-      if(!sib->is_visible)
-        continue;
-
-      tickit_rectset_subtract(visible, &sib->rect);
+    ChildIndex *index = _get_child_index_covering(parent, &win->rect);
+    ChildRow sibs;
+    if(index && _indexed_children(index, &win->rect, false, &sibs)) {
+      /* visible lies entirely within win, so only siblings overlapping that
+       * can obscure any of it
+       */
+      for(int i = 0; i < sibs.n && sibs.wins[i]->zorder < win->zorder; i++)
+        if(sibs.wins[i]->is_visible)
+          tickit_rectset_subtract(visible, &sibs.wins[i]->rect);
+      _release_indexed(parent, &sibs);
     }
+    else
+      for(TickitWindow *sib = parent->first_child; sib; sib = sib->next) {
+        if(sib == win)
+          break;
+        if(!sib->is_visible)
+          continue;
+
+        tickit_rectset_subtract(visible, &sib->rect);
+      }
 
     win = parent;
   }
@@ -1011,37 +2030,8 @@ static bool _scrollrectset(TickitWindow *win, TickitRectSet *visible, int downwa
       continue;
     }
 
-    // TODO: This may be more efficiently done with some rectset operations
-    //   instead of completely resetting and rebuilding the set
-    TickitRectSet *damageset = WINDOW_AS_ROOT(win)->damage;
-    int n_damage = tickit_rectset_rects(damageset);
-    TickitRect damage[n_damage];
-    tickit_rectset_get_rects(damageset, damage, n_damage);
-    tickit_rectset_clear(damageset);
-
-    for(int j = 0; j < n_damage; j++) {
-      TickitRect r = damage[j];
-
-      if(tickit_rect_bottom(&r) < rect.top || r.top > tickit_rect_bottom(&rect) ||
-         tickit_rect_right(&r) < rect.left || r.left > tickit_rect_right(&rect)) {
-        tickit_rectset_add(damageset, &r);
-        continue;
-      }
-
-      TickitRect outside[4];
-      int n_outside;
-      if((n_outside = tickit_rect_subtract(outside, &r, &rect))) {
-        for(int k = 0; k < n_outside; k++)
-          tickit_rectset_add(damageset, outside+k);
-      }
-
-      TickitRect inside;
-      if(tickit_rect_intersect(&inside, &r, &rect)) {
-        tickit_rect_translate(&inside, -downward, -rightward);
-        if(tickit_rect_intersect(&inside, &inside, &rect))
-          tickit_rectset_add(damageset, &inside);
-      }
-    }
+    // Pending damage within the scrolled area moves along with its content
+    tickit_rectset_translate_within(WINDOW_AS_ROOT(win)->damage, &rect, -downward, -rightward);
 
     DEBUG_LOGF("Wsr", "Term scrollrect " RECT_PRINTF_FMT " by %+d,%+d",
       RECT_PRINTF_ARGS(rect), rightward, downward);
@@ -1116,13 +2106,25 @@ static bool _scroll(TickitWindow *win, const TickitRect *origrect, int downward,
 
   tickit_rectset_add(visible, &rect);
 
-  if(mask_children)
+  ChildIndex *index;
+  ChildRow children;
+  if(mask_children && (index = _get_child_index_covering(win, &rect)) &&
+      _indexed_children(index, &rect, false, &children)) {
+    for(int i = 0; i < children.n; i++)
+      if(children.wins[i]->is_visible)
+        tickit_rectset_subtract(visible, &children.wins[i]->rect);
+    _release_indexed(win, &children);
+  }
+  else if(mask_children)
     for(TickitWindow *child = win->first_child; child; child = child->next) {
       if(!child->is_visible)
         continue;
       tickit_rectset_subtract(visible, &child->rect);
     }
 
+  if(win->cache)
+    _scroll_cache(win, &rect, downward, rightward);
+
   bool ret = _scrollrectset(win, visible, downward, rightward, pen);
 
   tickit_rectset_destroy(visible);
@@ -1264,6 +2266,32 @@ bool tickit_window_getctl_int(TickitWindow *win, TickitWindowCtl ctl, int *value
       *value = win->cursor.shape;
       return true;
 
+    case TICKIT_WINCTL_CHILD_INDEX:
+      *value = !!win->child_index;
+      return true;
+
+    case TICKIT_WINCTL_CACHED:
+      *value = !!win->cache;
+      return true;
+
+    case TICKIT_WINCTL_DAMAGE_MERGE_RECTS:
+      if(!win->is_root)
+        return false;
+      *value = WINDOW_AS_ROOT(win)->damage_merge_rects;
+      return true;
+
+    case TICKIT_WINCTL_DAMAGE_EXPOSE_COST:
+      if(!win->is_root)
+        return false;
+      *value = WINDOW_AS_ROOT(win)->damage_expose_cost;
+      return true;
+
+    case TICKIT_WINCTL_INPUT_DEFER_MSEC:
+      if(!win->is_root)
+        return false;
+      *value = WINDOW_AS_ROOT(win)->input_defer_msec;
+      return true;
+
     case TICKIT_N_WINCTLS:
       ;
   }
@@ -1275,6 +2303,7 @@ bool tickit_window_setctl_int(TickitWindow *win, TickitWindowCtl ctl, int value)
   switch(ctl) {
     case TICKIT_WINCTL_STEAL_INPUT:
       win->steal_input = value;
+      _invalidate_child_index(win->parent);
       return true;
 
     case TICKIT_WINCTL_FOCUS_CHILD_NOTIFY:
@@ -1293,6 +2322,44 @@ bool tickit_window_setctl_int(TickitWindow *win, TickitWindowCtl ctl, int value)
       win->cursor.shape = value;
       goto restore;
 
+    case TICKIT_WINCTL_CHILD_INDEX:
+      if(value && !win->child_index) {
+        win->child_index = malloc(sizeof(ChildIndex));
+        if(!win->child_index)
+          return false;
+        *win->child_index = (ChildIndex){ .dirty = true };
+      }
+      else if(!value && win->child_index) {
+        _destroy_child_index(win->child_index);
+        win->child_index = NULL;
+      }
+      return true;
+
+    case TICKIT_WINCTL_CACHED:
+      if(value && !win->cache)
+        return _create_cache(win);
+      else if(!value)
+        _destroy_cache(win);
+      return true;
+
+    case TICKIT_WINCTL_DAMAGE_MERGE_RECTS:
+      if(!win->is_root || value < 0)
+        return false;
+      WINDOW_AS_ROOT(win)->damage_merge_rects = value;
+      return true;
+
+    case TICKIT_WINCTL_DAMAGE_EXPOSE_COST:
+      if(!win->is_root || value < 0)
+        return false;
+      WINDOW_AS_ROOT(win)->damage_expose_cost = value;
+      return true;
+
+    case TICKIT_WINCTL_INPUT_DEFER_MSEC:
+      if(!win->is_root || value < 0)
+        return false;
+      WINDOW_AS_ROOT(win)->input_defer_msec = value;
+      return true;
+
     case TICKIT_N_WINCTLS:
       ;
   }
@@ -1305,22 +2372,29 @@ restore:
   return true;
 }
 
-static int _handle_key(TickitWindow *win, TickitKeyEventInfo *info)
+static int _handle_key(TickitWindow *win, TickitKeyEventInfo *info, const KeyLookup *key)
 {
   if(!win->is_visible)
     return 0;
 
+  /* Nothing in this subtree could take it, so don't visit any of it */
+  if(!_keys_may_handle(win, key))
+    return 0;
+
   int ret = 1;
   tickit_window_ref(win);
 
   if(win->first_child && win->first_child->steal_input)
-    if(_handle_key(win->first_child, info))
+    if(_handle_key(win->first_child, info, key))
       goto done;
 
   if(win->focused_child)
-    if(_handle_key(win->focused_child, info))
+    if(_handle_key(win->focused_child, info, key))
       goto done;
 
+  if(win->keymap && _run_keymap(win, info, key))
+    goto done;
+
   if(run_events_whilefalse(win, TICKIT_WINDOW_ON_KEY, info))
     goto done;
 
@@ -1332,7 +2406,7 @@ static int _handle_key(TickitWindow *win, TickitKeyEventInfo *info)
     if(child == win->focused_child)
       continue;
 
-    if(_handle_key(child, info))
+    if(_handle_key(child, info, key))
       goto done;
   }
 
@@ -1352,9 +2426,28 @@ static TickitWindow *_handle_mouse(TickitWindow *win, TickitMouseEventInfo *info
   TickitWindow *ret;
   tickit_window_ref(win);
 
+  /* With an index we need only try the children under the mouse, and any
+   * stealing input. A handler may close or destroy any of them, so each is
+   * held by a reference until we're done, and skipped once it has left us.
+   */
+  ChildRow indexed = { NULL };
+  int i = 0;
+  TickitRect point = { .top = info->line, .left = info->col, .lines = 1, .cols = 1 };
+  ChildIndex *index = _get_child_index_covering(win, &point);
+  if(index && !_indexed_children(index, &point, true, &indexed))
+    index = NULL;
+
+  for(int j = 0; j < indexed.n; j++)
+    tickit_window_ref(indexed.wins[j]);
+
   TickitWindow *next;
-  for(TickitWindow *child = win->first_child; child; child = next) {
-    next = child->next;
+  for(TickitWindow *child = index ? (indexed.n ? indexed.wins[0] : NULL) : win->first_child;
+      child;
+      child = next) {
+    next = index ? (++i < indexed.n ? indexed.wins[i] : NULL) : child->next;
+
+    if(index && (child->is_closed || child->parent != win))
+      continue;
 
     int child_line = info->line - child->rect.top;
     int child_col  = info->col  - child->rect.left;
@@ -1381,6 +2474,11 @@ static TickitWindow *_handle_mouse(TickitWindow *win, TickitMouseEventInfo *info
   ret = NULL;
   /* fallthrough */
 done:
+  if(index) {
+    for(int j = 0; j < indexed.n; j++)
+      tickit_window_unref(indexed.wins[j]);
+    _release_indexed(win, &indexed);
+  }
   tickit_window_unref(win);
 
   return ret;
@@ -1394,6 +2492,11 @@ const char *tickit_windowctl_name(TickitWindowCtl ctl)
     case TICKIT_WINCTL_CURSORVIS:          return "cursor-visible";
     case TICKIT_WINCTL_CURSORBLINK:        return "cursor-blink";
     case TICKIT_WINCTL_CURSORSHAPE:        return "cursor-shape";
+    case TICKIT_WINCTL_CHILD_INDEX:        return "child-index";
+    case TICKIT_WINCTL_DAMAGE_MERGE_RECTS: return "damage-merge-rects";
+    case TICKIT_WINCTL_DAMAGE_EXPOSE_COST: return "damage-expose-cost";
+    case TICKIT_WINCTL_INPUT_DEFER_MSEC:   return "input-defer-msec";
+    case TICKIT_WINCTL_CACHED:             return "cached";
 
     case TICKIT_N_WINCTLS: ;
   }
@@ -1418,9 +2521,14 @@ TickitType tickit_windowctl_type(TickitWindowCtl ctl)
     case TICKIT_WINCTL_FOCUS_CHILD_NOTIFY:
     case TICKIT_WINCTL_CURSORVIS:
     case TICKIT_WINCTL_CURSORBLINK:
+    case TICKIT_WINCTL_CHILD_INDEX:
+    case TICKIT_WINCTL_CACHED:
       return TICKIT_TYPE_BOOL;
 
     case TICKIT_WINCTL_CURSORSHAPE:
+    case TICKIT_WINCTL_DAMAGE_MERGE_RECTS:
+    case TICKIT_WINCTL_DAMAGE_EXPOSE_COST:
+    case TICKIT_WINCTL_INPUT_DEFER_MSEC:
       return TICKIT_TYPE_INT;
 
     case TICKIT_N_WINCTLS:
@@ -32,13 +32,20 @@ void test_add(const char *input, const char *output)
   TickitRect exp_outputs[4];
   int n_exp_outputs = rects_init_strp(exp_outputs, 4, output);
 
-  int reverse;
-  for(reverse = 0; reverse < 2; reverse++) {
+  static char *names[] = {
+    "tickit_rectset_add", "tickit_rectset_add reversed", "tickit_rectset_add_rects",
+  };
+
+  int mode;
+  for(mode = 0; mode < 3; mode++) {
     tickit_rectset_clear(trs);
 
     int i;
-    for(i = 0; i < n_inputs; i++)
-      tickit_rectset_add(trs, inputs + (reverse ? n_inputs - i - 1 : i));
+    if(mode == 2)
+      tickit_rectset_add_rects(trs, inputs, n_inputs);
+    else
+      for(i = 0; i < n_inputs; i++)
+        tickit_rectset_add(trs, inputs + (mode ? n_inputs - i - 1 : i));
 
     int n_got_outputs = tickit_rectset_rects(trs);
     TickitRect got_outputs[n_got_outputs];
@@ -69,11 +76,11 @@ void test_add(const char *input, const char *output)
       goto fail_dir;
     }
 
-    pass(reverse ? "tickit_rectset_add reversed" : "tickit_rectset_add");
+    pass(names[mode]);
     continue;
 
 fail_dir:
-    fail(reverse ? "tickit_rectset_add reversed" : "tickit_rectset_add");
+    fail(names[mode]);
   }
 
   tickit_rectset_destroy(trs);
@@ -184,6 +191,43 @@ int main(int argc, char *argv[])
     ok(!tickit_rectset_contains(trs, rect_init_strp(&tmp, "5,2..12,9")), "doesn't contain split");
     ok(!tickit_rectset_contains(trs, rect_init_strp(&tmp, "15,6..25,9")), "doesn't contain non-intersect");
 
+    tickit_rectset_clear(trs);
+
+    // Many small areas coalesce
+    TickitRect cells[80];
+    for(int i = 0; i < 80; i++)
+      tickit_rect_init_sized(cells + i, 3 + (i % 2), (i / 2) * 2, 1, 2);
+
+    tickit_rectset_add_rects(trs, cells, 80);
+
+    is_int(tickit_rectset_get_rects(trs, rects, 4), 1, "tickit_rectset_get_rects after tickit_rectset_add_rects");
+    is_rect(rects + 0, "0,3..80,5", "rects[0] after tickit_rectset_add_rects");
+
+    tickit_rectset_subtract(trs, rect_init_strp(&tmp, "10,3..20,4"));
+    tickit_rectset_subtract(trs, rect_init_strp(&tmp, "40,3..50,4"));
+
+    is_int(tickit_rectset_get_rects(trs, rects, 4), 4, "tickit_rectset_get_rects after tickit_rectset_subtract");
+    is_rect(rects + 0, "0,3..10,4",  "rects[0] after tickit_rectset_subtract");
+    is_rect(rects + 1, "20,3..40,4", "rects[1] after tickit_rectset_subtract");
+    is_rect(rects + 2, "50,3..80,4", "rects[2] after tickit_rectset_subtract");
+    is_rect(rects + 3, "0,4..80,5",  "rects[3] after tickit_rectset_subtract");
+
+    ok( tickit_rectset_intersects(trs, rect_init_strp(&tmp, "15,3..45,4")), "intersects between holes");
+    ok(!tickit_rectset_intersects(trs, rect_init_strp(&tmp, "12,2..18,4")), "doesn't intersect inside hole");
+    ok( tickit_rectset_contains(trs, rect_init_strp(&tmp, "0,3..5,5")), "contains across bands");
+    ok(!tickit_rectset_contains(trs, rect_init_strp(&tmp, "5,3..15,5")), "doesn't contain across hole");
+
+    // Translation within a clip
+    tickit_rectset_clear(trs);
+    tickit_rectset_add(trs, rect_init_strp(&tmp, "0,0..20,2"));
+    tickit_rectset_add(trs, rect_init_strp(&tmp, "0,8..20,10"));
+
+    tickit_rectset_translate_within(trs, rect_init_strp(&tmp, "0,1..20,10"), -3, 0);
+
+    is_int(tickit_rectset_get_rects(trs, rects, 4), 2, "tickit_rectset_get_rects after tickit_rectset_translate_within");
+    is_rect(rects + 0, "0,0..20,1", "rects[0] after tickit_rectset_translate_within");
+    is_rect(rects + 1, "0,5..20,7", "rects[1] after tickit_rectset_translate_within");
+
     tickit_rectset_destroy(trs);
   }
 
@@ -17,6 +17,16 @@ int delete(void *owner, TickitEventFlags flags, void *info, void *data)
   return 0;
 }
 
+static char order[16];
+static int order_len;
+
+int record(void *owner, TickitEventFlags flags, void *info, void *data)
+{
+  if(order_len < sizeof(order) - 1)
+    order[order_len++] = *(char *)data;
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   {
@@ -30,7 +40,6 @@ int main(int argc, char *argv[])
     is_int(count, 1, "binding after self-removal still invoked");
 
     tickit_bindings_unbind_and_destroy(&bindings, NULL);
-    bindings.first = NULL;
   }
 
   {
@@ -48,7 +57,6 @@ int main(int argc, char *argv[])
     is_int(count3, 1, "binding after removed one still invoked");
 
     tickit_bindings_unbind_and_destroy(&bindings, NULL);
-    bindings.first = NULL;
   }
 
   // TICKIT_BIND_ONESHOT
@@ -63,5 +71,52 @@ int main(int argc, char *argv[])
     is_int(count, 1, "count not incremented after second ONESHOT run");
   }
 
+  // ordering across events
+  {
+    order_len = 0;
+    tickit_bindings_bind_event(&bindings, NULL, 1, 0, &record, "b");
+    tickit_bindings_bind_event(&bindings, NULL, 2, 0, &record, "x");
+    tickit_bindings_bind_event(&bindings, NULL, 1, 0, &record, "c");
+    tickit_bindings_bind_event(&bindings, NULL, 1, TICKIT_BIND_FIRST, &record, "a");
+    tickit_bindings_bind_event(&bindings, NULL, 2, TICKIT_BIND_FIRST|TICKIT_BIND_DESTROY, &record, "w");
+    tickit_bindings_bind_event(&bindings, NULL, 1, TICKIT_BIND_DESTROY, &record, "d");
+    tickit_bindings_bind_event(&bindings, NULL, 0, 0, &record, "z");
+
+    tickit_bindings_run_event(&bindings, NULL, 1, NULL);
+    tickit_bindings_run_event(&bindings, NULL, 2, NULL);
+    order[order_len] = 0;
+    is_str(order, "abcdwx", "bindings run in order within each event");
+
+    order_len = 0;
+    tickit_bindings_unbind_and_destroy(&bindings, NULL);
+    order[order_len] = 0;
+    is_str(order, "zdw", "destroy runs in reverse order across all events");
+  }
+
+  // IDs
+  {
+    int count = 0;
+    int ids[100];
+    for(int i = 0; i < 100; i++)
+      ids[i] = tickit_bindings_bind_event(&bindings, NULL, 1 + i % 3, 0, &incr, &count);
+
+    for(int i = 0; i < 100; i += 2)
+      tickit_bindings_unbind_event_id(&bindings, NULL, ids[i]);
+
+    int id = tickit_bindings_bind_event(&bindings, NULL, 1, 0, &incr, &count);
+    ok(id > ids[99], "new ID after unbind is not reused");
+
+    tickit_bindings_unbind_event_id(&bindings, NULL, id);
+    for(int i = 1; i < 100; i += 4)
+      tickit_bindings_unbind_event_id(&bindings, NULL, ids[i]);
+
+    tickit_bindings_run_event(&bindings, NULL, 1, NULL);
+    tickit_bindings_run_event(&bindings, NULL, 2, NULL);
+    tickit_bindings_run_event(&bindings, NULL, 3, NULL);
+    is_int(count, 25, "only the remaining bindings are invoked after unbinding by ID");
+
+    tickit_bindings_unbind_and_destroy(&bindings, NULL);
+  }
+
   return exit_status();
 }
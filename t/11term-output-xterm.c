@@ -11,6 +11,12 @@ void output(TickitTerm *tt, const char *bytes, size_t len, void *user)
   strncat(buffer, bytes, len);
 }
 
+int on_capschange(TickitTerm *tt, TickitEventFlags flags, void *info, void *user)
+{
+  (*(int *)user)++;
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   TickitTerm *tt;
@@ -168,6 +174,45 @@ int main(int argc, char *argv[])
   tickit_term_erasech(tt, 3, 1);
   is_str_escape(buffer, "\e[3X\e[3C", "buffer after tickit_term_erasech 3 move");
 
+  /* Replies that arrive after the application has already changed a mode
+   * don't override it
+   */
+  {
+    tickit_term_setctl_int(tt, TICKIT_TERMCTL_CURSORVIS, 0);
+    tickit_term_input_push_bytes(tt, "\e[?25;1$y", 9);
+
+    int value;
+    tickit_term_getctl_int(tt, TICKIT_TERMCTL_CURSORVIS, &value);
+    is_int(value, 0, "CURSORVIS stays off after a late mode report");
+
+    buffer[0] = 0;
+    tickit_term_setctl_int(tt, TICKIT_TERMCTL_CURSORSHAPE, TICKIT_CURSORSHAPE_UNDER);
+    is_str_escape(buffer, "", "buffer empty after setting CURSORSHAPE before it is known supported");
+
+    tickit_term_input_push_bytes(tt, "\eP1$r2 q\e\\", 10);
+    is_str_escape(buffer, "\e[4 q", "buffer after late DECSCUSR reply applies the requested CURSORSHAPE");
+  }
+
+  /* A late reply revealing RGB8 support announces a capability change */
+  {
+    int count = 0;
+    tickit_term_bind_event(tt, TICKIT_TERM_ON_CAPSCHANGE, 0, &on_capschange, &count);
+
+    int colors;
+    tickit_term_getctl_int(tt, TICKIT_TERMCTL_COLORS, &colors);
+    is_int(colors, 256, "COLORS before RGB8 reply");
+
+    tickit_term_input_push_bytes(tt, "\eP1$r38:2:0:1:2m\e\\", 18);
+
+    is_int(count, 1, "TICKIT_TERM_ON_CAPSCHANGE invoked after RGB8 reply");
+    tickit_term_getctl_int(tt, TICKIT_TERMCTL_COLORS, &colors);
+    is_int(colors, 1<<24, "COLORS after RGB8 reply");
+
+    tickit_term_input_push_bytes(tt, "\eP1$r38:2:0:1:2m\e\\", 18);
+
+    is_int(count, 1, "TICKIT_TERM_ON_CAPSCHANGE not invoked again for a repeated reply");
+  }
+
   tickit_term_unref(tt);
   pass("tickit_term_unref");
 
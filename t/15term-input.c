@@ -11,6 +11,7 @@
 TickitKeyEventType keytype;
 char               keystr[16];
 int                keymod;
+int                keycode;
 
 int on_key_return = 1;
 
@@ -21,6 +22,7 @@ int on_key(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
   keytype = info->type;
   strncpy(keystr, info->str, sizeof(keystr)-1); keystr[sizeof(keystr)-1] = 0;
   keymod = info->mod;
+  keycode = info->code;
 
   return on_key_return;
 }
@@ -31,9 +33,16 @@ int on_key_incr(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
   return 1;
 }
 
+int on_key_count(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
+{
+  (*(int *)data)++;
+  return 0;
+}
+
 TickitMouseEventType mousetype;
 int mousebutton, mouseline, mousecol;
 int mousemod;
+int mousecount;
 
 int on_mouse(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
 {
@@ -44,10 +53,24 @@ int on_mouse(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
   mouseline   = info->line;
   mousecol    = info->col;
   mousemod    = info->mod;
+  mousecount  = info->count;
 
   return 1;
 }
 
+int on_mouse_count(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
+{
+  (*(int *)data)++;
+  return 0;
+}
+
+int on_key_set_utf8(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
+{
+  /* Changes how keys are named while this one is still being delivered */
+  tickit_term_set_utf8(tt, 1);
+  return 0;
+}
+
 char events[2];
 uint8_t i = 0;
 
@@ -90,6 +113,7 @@ int main(int argc, char *argv[])
   is_int(keytype, TICKIT_KEYEV_TEXT, "keytype after push_bytes A");
   is_str(keystr,  "A",               "keystr after push_bytes A");
   is_int(keymod,  0,                 "keymod after push_bytes A");
+  is_int(keycode, 'A',               "keycode after push_bytes A");
 
   is_int(tickit_term_input_check_timeout_msec(tt), -1, "term has no timeout after A");
 
@@ -101,18 +125,37 @@ int main(int argc, char *argv[])
   is_int(keytype, TICKIT_KEYEV_TEXT, "keytype after push_bytes U+0109");
   is_str(keystr,  "\xc4\x89",        "keystr after push_bytes U+0109");
   is_int(keymod,  0,                 "keymod after push_bytes U+0109");
+  is_int(keycode, 0x109,             "keycode after push_bytes U+0109");
 
   tickit_term_input_push_bytes(tt, "\e[A", 3);
 
   is_int(keytype, TICKIT_KEYEV_KEY, "keytype after push_bytes Up");
   is_str(keystr,  "Up",             "keystr after push_bytes Up");
   is_int(keymod,  0,                 "keymod after push_bytes Up");
+  is_int(keycode, TICKIT_KEY_UP,     "keycode after push_bytes Up");
 
   tickit_term_input_push_bytes(tt, "\x01", 1);
 
   is_int(keytype, TICKIT_KEYEV_KEY, "keytype after push_bytes C-a");
   is_str(keystr,  "C-a",            "keystr after push_bytes C-a");
   is_int(keymod,  TICKIT_MOD_CTRL,  "keymod after push_bytes C-a");
+  is_int(keycode, 'a',              "keycode after push_bytes C-a");
+
+  tickit_term_input_push_bytes(tt, "\e[15;5~", 7);
+
+  is_int(keytype, TICKIT_KEYEV_KEY,   "keytype after push_bytes C-F5");
+  is_str(keystr,  "C-F5",             "keystr after push_bytes C-F5");
+  is_int(keycode, TICKIT_KEY_F(5),    "keycode after push_bytes C-F5");
+
+  tickit_term_input_push_bytes(tt, "\e[1;5A", 6);
+  tickit_term_input_push_bytes(tt, "\e[A", 3);
+
+  is_str(keystr,  "Up",             "keystr after push_bytes Up again");
+
+  tickit_term_input_push_bytes(tt, "\e[1;5A", 6);
+
+  is_str(keystr,  "C-Up",           "keystr after push_bytes C-Up again");
+  is_int(keycode, TICKIT_KEY_UP,    "keycode after push_bytes C-Up");
 
   is_int(tickit_term_input_check_timeout_msec(tt), -1, "term has no timeout after Up");
 
@@ -156,6 +199,44 @@ int main(int argc, char *argv[])
   is_int(mouseline,   0,                    "mouseline after mouse wheel up");
   is_int(mousecol,    0,                    "mousecol after mouse wheel up");
   is_int(mousemod,    0,                    "mousemod after mouse wheel up");
+  is_int(mousecount,  1,                    "mousecount after mouse wheel up");
+
+  // Mouse coalescing
+  {
+    int count = 0;
+    int bind_id = tickit_term_bind_event(tt, TICKIT_TERM_ON_MOUSE, TICKIT_BIND_FIRST, &on_mouse_count, &count);
+
+    tickit_term_setctl_int(tt, TICKIT_TERMCTL_MOUSE_COALESCE, 1);
+
+    tickit_term_input_push_bytes(tt, "\e[M !!\e[M@\"!\e[M@#!\e[M@$!", 24);
+
+    is_int(count,       2,                  "press and one drag delivered from coalesced drags");
+    is_int(mousetype,   TICKIT_MOUSEEV_DRAG, "mousetype after coalesced drags");
+    is_int(mousecol,    3,                  "mousecol after coalesced drags is the latest");
+
+    count = 0;
+    tickit_term_input_push_bytes(tt, "\e[M@%!\e[M#%!", 12);
+
+    is_int(count,       2,                     "drag then release not coalesced");
+    is_int(mousetype,   TICKIT_MOUSEEV_RELEASE, "mousetype after drag then release");
+
+    count = 0;
+    tickit_term_input_push_bytes(tt, "\e[M`!!\e[M`!!\e[M`!!", 18);
+
+    is_int(count,       1,                    "one event for coalesced wheel steps");
+    is_int(mousebutton, TICKIT_MOUSEWHEEL_UP, "mousebutton after coalesced wheel steps");
+    is_int(mousecount,  3,                    "mousecount after coalesced wheel steps");
+
+    count = 0;
+    tickit_term_input_push_bytes(tt, "\e[M`!!\e[Ma!!", 12);
+
+    is_int(count,       2,                      "wheel up and down not coalesced");
+    is_int(mousebutton, TICKIT_MOUSEWHEEL_DOWN, "mousebutton after wheel up and down");
+    is_int(mousecount,  1,                      "mousecount after wheel up and down");
+
+    tickit_term_setctl_int(tt, TICKIT_TERMCTL_MOUSE_COALESCE, 0);
+    tickit_term_unbind_event_id(tt, bind_id);
+  }
 
   keytype = -1; keystr[0] = 0;
   tickit_term_input_push_bytes(tt, "\e[", 2);
@@ -189,6 +270,78 @@ int main(int argc, char *argv[])
 
   is_int(tickit_term_input_check_timeout_msec(tt), -1, "term has no timeout after completed Escape");
 
+  // Bracketed paste
+  {
+    keytype = -1; keystr[0] = 0;
+    tickit_term_input_push_bytes(tt, "\e[200~Hi\tthere\r\x01", 16);
+
+    is_int(keytype, -1, "keytype not set during bracketed paste");
+
+    tickit_term_input_push_bytes(tt, "\e[201~", 6);
+
+    is_int(keytype, TICKIT_KEYEV_PASTE, "keytype after bracketed paste");
+    is_str(keystr,  "Hi\tthere\n\x01", "keystr after bracketed paste");
+
+    keytype = -1;
+    tickit_term_input_push_bytes(tt, "B", 1);
+
+    is_int(keytype, TICKIT_KEYEV_TEXT, "keytype after push_bytes B following paste");
+  }
+
+  // Bracketed paste control characters
+  {
+    tickit_term_input_push_bytes(tt, "\e[200~a\r\nb\nc\e[201~", 18);
+
+    is_str(keystr,  "a\nb\nc", "keystr after bracketed paste with CRLF collapses to one newline");
+
+    tickit_term_input_push_bytes(tt, "\e[200~ab\x7f\x08" "c\e[201~", 17);
+
+    is_str(keystr,  "ab\x7f\x08" "c", "keystr after bracketed paste keeps backspace and DEL");
+
+    tickit_term_input_push_bytes(tt, "\e[200~a\0b\e[201~", 15);
+
+    is_str(keystr,  "ab", "keystr after bracketed paste skips NUL");
+  }
+
+  // Text batching
+  {
+    int count = 0;
+    int bind_id = tickit_term_bind_event(tt, TICKIT_TERM_ON_KEY, TICKIT_BIND_FIRST, &on_key_count, &count);
+
+    int value;
+    ok(tickit_term_getctl_int(tt, TICKIT_TERMCTL_TEXT_BATCH, &value) && !value,
+        "TICKIT_TERMCTL_TEXT_BATCH initially off");
+
+    tickit_term_setctl_int(tt, TICKIT_TERMCTL_TEXT_BATCH, 1);
+
+    tickit_term_input_push_bytes(tt, "Hello, world\xc4\x89", 14);
+
+    is_int(count,   1,                      "one event for batched text");
+    is_int(keytype, TICKIT_KEYEV_TEXT,      "keytype after batched text");
+    is_str(keystr,  "Hello, world\xc4\x89", "keystr after batched text");
+
+    count = 0;
+    tickit_term_input_push_bytes(tt, "ab\rcd", 5);
+
+    is_int(count,   3,                 "three events for text split by Enter");
+    is_str(keystr,  "cd",              "keystr after text split by Enter");
+
+    count = 0;
+    tickit_term_input_push_bytes(tt, "\e[Axyz", 6);
+
+    is_int(count,   2,                 "two events for Up followed by text");
+    is_str(keystr,  "xyz",             "keystr after Up followed by text");
+
+    tickit_term_setctl_int(tt, TICKIT_TERMCTL_TEXT_BATCH, 0);
+
+    count = 0;
+    tickit_term_input_push_bytes(tt, "ab", 2);
+
+    is_int(count,   2,                 "one event per key with batching off");
+
+    tickit_term_unbind_event_id(tt, bind_id);
+  }
+
   {
     int count = 0;
     int bind_id = tickit_term_bind_event(tt, TICKIT_TERM_ON_KEY, 0, &on_key_incr, &count);
@@ -210,6 +363,22 @@ int main(int argc, char *argv[])
     tickit_term_unbind_event_id(tt, bind_id);
   }
 
+  // Key names outlive a handler changing UTF-8 mode
+  {
+    int bind_id = tickit_term_bind_event(tt, TICKIT_TERM_ON_KEY, TICKIT_BIND_FIRST, &on_key_set_utf8, NULL);
+
+    tickit_term_input_push_bytes(tt, "\x01", 1);
+
+    is_int(keytype, TICKIT_KEYEV_KEY, "keytype after push_bytes C-a with handler changing UTF-8");
+    is_str(keystr,  "C-a",            "keystr after push_bytes C-a with handler changing UTF-8");
+
+    tickit_term_unbind_event_id(tt, bind_id);
+
+    tickit_term_input_push_bytes(tt, "\x01", 1);
+
+    is_str(keystr,  "C-a",            "keystr after push_bytes C-a after key names cleared");
+  }
+
   {
     int bindA_id = tickit_term_bind_event(tt, TICKIT_TERM_ON_KEY, 0,                 &on_key_push, "A");
     int bindB_id = tickit_term_bind_event(tt, TICKIT_TERM_ON_KEY, TICKIT_BIND_FIRST, &on_key_push, "B");
@@ -11,6 +11,14 @@
 TickitKeyEventType keytype;
 char               keystr[16];
 
+int on_key_count(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
+{
+  int *ip = data;
+  (*ip)++;
+
+  return 1;
+}
+
 int on_key(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
 {
   TickitKeyEventInfo *info = _info;
@@ -21,6 +29,18 @@ int on_key(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
   return 1;
 }
 
+char keystrs[64];
+
+int on_key_append(TickitTerm *tt, TickitEventFlags flags, void *_info, void *data)
+{
+  TickitKeyEventInfo *info = _info;
+
+  strncat(keystrs, info->str, sizeof(keystrs) - strlen(keystrs) - 2);
+  strcat(keystrs, "|");
+
+  return 1;
+}
+
 int main(int argc, char *argv[])
 {
   TickitTerm *tt;
@@ -70,5 +90,55 @@ int main(int argc, char *argv[])
 
   tickit_term_unref(tt);
 
+  // input_buffersize
+  {
+    tt = tickit_term_build(&(struct TickitTermBuilder){
+      .termtype         = "xterm",
+      .open             = TICKIT_OPEN_FDS,
+      .input_fd         = fd[0],
+      .output_fd        = -1,
+      .input_buffersize = 8192,
+    });
+
+    int count = 0;
+    tickit_term_bind_event(tt, TICKIT_TERM_ON_KEY, 0, on_key_count, &count);
+
+    char buffer[5000];
+    memset(buffer, 'x', sizeof buffer);
+
+    write(fd[1], buffer, sizeof buffer);
+    tickit_term_input_readable(tt);
+
+    is_int(count, 5000, "input_buffersize reads all pending input at once");
+
+    count = 0;
+    tickit_term_input_push_bytes(tt, buffer, sizeof buffer);
+
+    is_int(count, 5000, "tickit_term_input_push_bytes accepts input larger than buffer");
+
+    tickit_term_unref(tt);
+  }
+
+  // Text batching from the input buffer
+  {
+    tt = tickit_term_build(&(struct TickitTermBuilder){
+      .termtype  = "xterm",
+      .open      = TICKIT_OPEN_FDS,
+      .input_fd  = fd[0],
+      .output_fd = -1,
+    });
+
+    tickit_term_setctl_int(tt, TICKIT_TERMCTL_TEXT_BATCH, 1);
+    tickit_term_bind_event(tt, TICKIT_TERM_ON_KEY, 0, on_key_append, NULL);
+
+    keystrs[0] = 0;
+    write(fd[1], "ab\rcd", 5);
+    tickit_term_input_readable(tt);
+
+    is_str(keystrs, "ab|Enter|cd|", "batched text read from input split by Enter");
+
+    tickit_term_unref(tt);
+  }
+
   return exit_status();
 }
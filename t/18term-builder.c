@@ -1,7 +1,14 @@
+#ifdef __GLIBC__
+#  define _XOPEN_SOURCE 700 // mkdtemp, setenv
+#endif
+
 #include "tickit.h"
 #include "taplib.h"
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #define streq(a,b) (!strcmp(a,b))
 
@@ -19,6 +26,18 @@ static void output(TickitTerm *tt, const char *bytes, size_t len, void *user)
   strncat(buffer, bytes, len);
 }
 
+static void output_discard(TickitTerm *tt, const char *bytes, size_t len, void *user)
+{
+}
+
+static int getctl(TickitTerm *tt, const char *name)
+{
+  TickitTermCtl ctl = tickit_termctl_lookup(name);
+  int value = -1;
+  tickit_term_getctl_int(tt, ctl, &value);
+  return value;
+}
+
 int main(int argc, char *argv[])
 {
   // getstr override
@@ -54,5 +73,62 @@ int main(int argc, char *argv[])
     }
   }
 
+  // capcache
+  {
+    char dir[] = "/tmp/tickit-capcache.XXXXXX";
+    if(!mkdtemp(dir)) {
+      perror("mkdtemp");
+      exit(1);
+    }
+    setenv("XDG_CACHE_HOME", dir, 1);
+    setenv("TERM_PROGRAM", "TestTerm", 1);
+    unsetenv("TERM_PROGRAM_VERSION");
+
+    struct TickitTermBuilder builder = {
+      .termtype    = "xterm",
+      .output_func = output_discard,
+      .capcache    = true,
+    };
+
+    TickitTerm *tt = tickit_term_build(&builder);
+
+    is_int(getctl(tt, "xterm.cap_rgb8"), 0, "xterm.cap_rgb8 initially 0 with empty cache");
+
+    tickit_term_input_push_bytes(tt, "\e[?69;1$y", 9);
+    tickit_term_input_push_bytes(tt, "\eP1$r38:2:0:1:2m\e\\", 18);
+
+    is_int(getctl(tt, "xterm.cap_rgb8"), 1, "xterm.cap_rgb8 1 after reply");
+
+    tickit_term_unref(tt);
+
+    tt = tickit_term_build(&builder);
+
+    is_int(getctl(tt, "xterm.cap_rgb8"), 1, "xterm.cap_rgb8 loaded from cache");
+    is_int(getctl(tt, "xterm.cap_slrm"), 1, "xterm.cap_slrm loaded from cache");
+    is_int(getctl(tt, "xterm.cap_csi_sub_colon"), 1, "xterm.cap_csi_sub_colon loaded from cache");
+
+    // The terminal no longer claims rgb8 nor DECSLRM
+    tickit_term_input_push_bytes(tt, "\eP1$r38:5:255m\e\\", 17);
+
+    is_int(getctl(tt, "xterm.cap_rgb8"), 0, "xterm.cap_rgb8 revalidated by reply");
+    is_int(getctl(tt, "xterm.cap_slrm"), 0, "xterm.cap_slrm revalidated by reply");
+
+    tickit_term_unref(tt);
+
+    setenv("TERM_PROGRAM", "OtherTerm", 1);
+    tt = tickit_term_build(&builder);
+
+    is_int(getctl(tt, "xterm.cap_csi_sub_colon"), 0, "cache not shared between different TERM_PROGRAM");
+
+    tickit_term_unref(tt);
+
+    char path[sizeof dir + 16];
+    sprintf(path, "%s/tickit/caps", dir);
+    unlink(path);
+    sprintf(path, "%s/tickit", dir);
+    rmdir(path);
+    rmdir(dir);
+  }
+
   return exit_status();
 }
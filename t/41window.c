@@ -101,6 +101,30 @@ int main(int argc, char *argv[])
     tickit_window_flush(root);
   }
 
+  // cached absolute geometry follows ancestors
+  {
+    TickitWindow *mid = tickit_window_new(root, (TickitRect){2, 2, 10, 40}, 0);
+    TickitWindow *subwin = tickit_window_new(mid, (TickitRect){1, 3, 1, 10}, 0);
+    tickit_window_flush(root);
+
+    TickitRect geom = tickit_window_get_abs_geometry(subwin);
+    is_rect(&geom, "5,3+10,1", "deeply nested tickit_window_get_abs_geometry");
+
+    tickit_window_reposition(mid, 4, 6);
+
+    geom = tickit_window_get_abs_geometry(subwin);
+    is_rect(&geom, "9,5+10,1", "deeply nested tickit_window_get_abs_geometry after parent reposition");
+
+    tickit_window_resize(subwin, 2, 8);
+
+    geom = tickit_window_get_abs_geometry(subwin);
+    is_rect(&geom, "9,5+8,2", "deeply nested tickit_window_get_abs_geometry after resize");
+
+    tickit_window_unref(subwin);
+    tickit_window_unref(mid);
+    tickit_window_flush(root);
+  }
+
   // initially-hidden
   {
     TickitWindow *subwin = tickit_window_new(win, (TickitRect){4, 4, 2, 2}, TICKIT_WINDOW_HIDDEN);
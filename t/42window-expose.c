@@ -25,6 +25,40 @@ int on_expose_pushrect(TickitWindow *win, TickitEventFlags flags, void *_info, v
   return 1;
 }
 
+int on_expose_pushvisible(TickitWindow *win, TickitEventFlags flags, void *_info, void *data)
+{
+  TickitExposeEventInfo *info = _info;
+
+  next_rect += tickit_rectset_get_rects(info->visible, exposed_rects + next_rect,
+      sizeof(exposed_rects)/sizeof(exposed_rects[0]) - next_rect);
+  return 1;
+}
+
+int on_expose_render_lines(TickitWindow *win, TickitEventFlags flags, void *_info, void *data)
+{
+  TickitExposeEventInfo *info = _info;
+
+  (*(int *)data)++;
+
+  for(int line = info->rect.top; line < tickit_rect_bottom(&info->rect); line++)
+    tickit_renderbuffer_textf_at(info->rb, line, 0, "Cached %d", line);
+
+  return 1;
+}
+
+int on_expose_render_reexpose(TickitWindow *win, TickitEventFlags flags, void *_info, void *data)
+{
+  TickitExposeEventInfo *info = _info;
+
+  /* Content changed while it was being drawn */
+  if((*(int *)data)++ == 0)
+    tickit_window_expose(win, NULL);
+
+  tickit_renderbuffer_textf_at(info->rb, 0, 0, "Render %d", *(int *)data);
+
+  return 1;
+}
+
 int on_expose_render_text(TickitWindow *win, TickitEventFlags flags, void *_info, void *data)
 {
   TickitExposeEventInfo *info = _info;
@@ -116,7 +150,7 @@ int main(int argc, char *argv[])
 
     tickit_window_flush(root);
 
-    is_int(root_exposed, 2, "root expose count after expose on win");
+    is_int(root_exposed, 1, "root expose count after expose on win");
     is_int(win_exposed,  2, "win expose count after expose on win");
 
     is_int(next_rect, 1, "pushed 1 exposed rect");
@@ -129,7 +163,7 @@ int main(int argc, char *argv[])
 
     tickit_window_flush(root);
 
-    is_int(root_exposed, 3, "root expose count after expose on root-then-win");
+    is_int(root_exposed, 2, "root expose count after expose on root-then-win");
     is_int(win_exposed,  3, "win expose count after expose on root-then-win");
 
     tickit_window_expose(win, NULL);
@@ -137,21 +171,21 @@ int main(int argc, char *argv[])
 
     tickit_window_flush(root);
 
-    is_int(root_exposed, 4, "root expose count after expose on win-then-root");
+    is_int(root_exposed, 3, "root expose count after expose on win-then-root");
     is_int(win_exposed,  4, "win expose count after expose on win-then-root");
 
     tickit_window_hide(win);
 
     tickit_window_flush(root);
 
-    is_int(root_exposed, 5, "root expose count after hide");
+    is_int(root_exposed, 4, "root expose count after hide");
     is_int(win_exposed,  4, "win expose count after hide");
 
     tickit_window_show(win);
 
     tickit_window_flush(root);
 
-    is_int(root_exposed, 6, "root expose count after show");
+    is_int(root_exposed, 4, "root expose count after show");
     is_int(win_exposed,  5, "win expose count after show");
 
     next_rect = 0;
@@ -245,8 +279,7 @@ int main(int argc, char *argv[])
 
     is_int(exposed, 1, "New child window is immediately exposed");
 
-    is_int(next_rect, 1, "pushed 1 exposed rect");
-    is_rect(exposed_rects+0, "4,1+6,3", "exposed_rects[0]");
+    is_int(next_rect, 0, "parent covered by new child window is not exposed");
 
     next_rect = 0;
 
@@ -346,8 +379,147 @@ int main(int argc, char *argv[])
     tickit_window_unbind_event_id(win, bind_id);
   }
 
+  // Visible region excludes children
+  {
+    next_rect = 0;
+    int bind_id = tickit_window_bind_event(win, TICKIT_WINDOW_ON_EXPOSE, 0, &on_expose_pushvisible, NULL);
+
+    TickitWindow *sub = tickit_window_new(win, (TickitRect){1, 5, 2, 10}, 0);
+    tickit_window_flush(root);
+
+    next_rect = 0;
+
+    tickit_window_expose(win, &(TickitRect){ .top = 0, .left = 0, .lines = 2, .cols = 20 });
+    tickit_window_flush(root);
+
+    is_int(next_rect, 3, "pushed 3 visible rects");
+    is_rect(exposed_rects+0, "0,0+20,1", "exposed_rects[0]");
+    is_rect(exposed_rects+1, "0,1+5,1",  "exposed_rects[1]");
+    is_rect(exposed_rects+2, "15,1+5,1", "exposed_rects[2]");
+
+    tickit_window_unref(sub);
+    tickit_window_flush(root);
+    tickit_window_unbind_event_id(win, bind_id);
+  }
+
   tickit_window_unref(win);
 
+  // Fragmented damage is simplified
+  {
+    tickit_window_flush(root);
+
+    int value;
+    ok(tickit_window_getctl_int(root, TICKIT_WINCTL_DAMAGE_MERGE_RECTS, &value) && value == 16,
+        "tickit_window_getctl_int TICKIT_WINCTL_DAMAGE_MERGE_RECTS default");
+    ok(tickit_window_getctl_int(root, TICKIT_WINCTL_DAMAGE_EXPOSE_COST, &value) && value == 80,
+        "tickit_window_getctl_int TICKIT_WINCTL_DAMAGE_EXPOSE_COST default");
+
+    root_exposed = 0;
+    for(int i = 0; i < 40; i++)
+      tickit_window_expose(root, &(TickitRect){ .top = 12 + (i % 2), .left = i * 2, .lines = 1, .cols = 1 });
+    tickit_window_flush(root);
+
+    is_int(root_exposed, 1, "root exposed once for many scattered cells");
+
+    root_exposed = 0;
+    for(int i = 0; i < 40; i++)
+      tickit_window_expose(root, &(TickitRect){ .top = (i % 2) ? 2 : 22, .left = i * 2, .lines = 1, .cols = 1 });
+    tickit_window_flush(root);
+
+    is_int(root_exposed, 2, "root exposed once per distant run of damage");
+
+    ok(tickit_window_setctl_int(root, TICKIT_WINCTL_DAMAGE_MERGE_RECTS, 0),
+        "tickit_window_setctl_int TICKIT_WINCTL_DAMAGE_MERGE_RECTS");
+
+    root_exposed = 0;
+    for(int i = 0; i < 40; i++)
+      tickit_window_expose(root, &(TickitRect){ .top = 12 + (i % 2), .left = i * 2, .lines = 1, .cols = 1 });
+    tickit_window_flush(root);
+
+    is_int(root_exposed, 40, "root exposed for each cell with simplification disabled");
+
+    tickit_window_setctl_int(root, TICKIT_WINCTL_DAMAGE_MERGE_RECTS, 16);
+  }
+
+  // Cached windows
+  {
+    TickitWindow *cwin = tickit_window_new(root, (TickitRect){15, 0, 3, 80}, 0);
+    ok(tickit_window_setctl_int(cwin, TICKIT_WINCTL_CACHED, 1), "tickit_window_setctl_int TICKIT_WINCTL_CACHED");
+
+    int rendered = 0;
+    tickit_window_bind_event(cwin, TICKIT_WINDOW_ON_EXPOSE, 0, &on_expose_render_lines, &rendered);
+
+    tickit_window_flush(root);
+    drain_termlog();
+    rendered = 0;
+
+    tickit_window_expose(cwin, NULL);
+    tickit_window_flush(root);
+
+    is_int(rendered, 1, "cached window rendered after expose");
+    is_termlog("Termlog after cached window expose",
+        GOTO(15,0), SETPEN(), PRINT("Cached 0"),
+        GOTO(16,0), SETPEN(), PRINT("Cached 1"),
+        GOTO(17,0), SETPEN(), PRINT("Cached 2"),
+        NULL);
+
+    TickitWindow *popup = tickit_window_new(root, (TickitRect){16, 0, 1, 10}, 0);
+    tickit_window_flush(root);
+    tickit_window_hide(popup);
+    tickit_window_flush(root);
+
+    is_int(rendered, 1, "cached window not rendered again after popup hidden");
+    is_termlog("Termlog after popup over cached window hidden",
+        GOTO(16,0), SETPEN(), PRINT("Cached 1"),
+        NULL);
+
+    tickit_window_scroll(cwin, 1, 0);
+    tickit_window_flush(root);
+
+    is_int(rendered, 2, "cached window rendered again after scroll");
+    is_termlog("Termlog after cached window scroll",
+        SETPEN(),
+        SCROLLRECT(15,0,3,80, +1,0),
+        GOTO(17,0), SETPEN(), PRINT("Cached 2"),
+        NULL);
+
+    tickit_window_expose(root, &(TickitRect){15, 0, 3, 80});
+    tickit_window_flush(root);
+
+    is_int(rendered, 2, "cached window not rendered again after root expose");
+    is_termlog("Termlog after root expose over cached window",
+        GOTO(15,0), SETPEN(), PRINT("Cached 1"),
+        GOTO(16,0), SETPEN(), PRINT("Cached 2"),
+        GOTO(17,0), SETPEN(), PRINT("Cached 2"),
+        NULL);
+
+    tickit_window_unref(popup);
+    tickit_window_unref(cwin);
+    tickit_window_flush(root);
+  }
+
+  // Cached window exposed again by its own expose handler
+  {
+    TickitWindow *cwin = tickit_window_new(root, (TickitRect){20, 0, 1, 80}, 0);
+    tickit_window_setctl_int(cwin, TICKIT_WINCTL_CACHED, 1);
+
+    int rendered = 0;
+    tickit_window_bind_event(cwin, TICKIT_WINDOW_ON_EXPOSE, 0, &on_expose_render_reexpose, &rendered);
+
+    tickit_window_flush(root);
+    drain_termlog();
+
+    tickit_window_flush(root);
+
+    is_int(rendered, 2, "cached window rendered again after exposing itself while rendering");
+    is_termlog("Termlog after cached window exposed itself while rendering",
+        GOTO(20,0), SETPEN(), PRINT("Render 2"),
+        NULL);
+
+    tickit_window_unref(cwin);
+    tickit_window_flush(root);
+  }
+
   // Window ordering
   {
     TickitWindow *winA = tickit_window_new(root, (TickitRect){0, 0, 4, 80}, 0);
@@ -228,6 +228,91 @@ int main(int argc, char *argv[])
     tickit_window_unbind_event_id(subwin, bind_ids[1]);
   }
 
+  // Key maps
+  {
+    TickitWindow *otherwin = tickit_window_new(root, (TickitRect){10, 10, 4, 20}, 0);
+    tickit_window_show(subwin);
+    tickit_window_take_focus(subwin);
+    tickit_window_flush(root);
+
+    struct LastEvent win_key = { .ret = 1 }, subwin_key = { .ret = 1 };
+
+    int ca_id = tickit_window_bind_key(win, "a", TICKIT_MOD_CTRL, 0, &on_key_event_capture, &win_key);
+    tickit_window_bind_key(subwin, "Enter", 0, 0, &on_key_event_capture, &subwin_key);
+
+    press_key(TICKIT_KEYEV_KEY, "C-a", TICKIT_MOD_CTRL);
+
+    is_str(win_key.str, "C-a", "win key map receives C-a");
+    is_int(win_key.mod, TICKIT_MOD_CTRL, "win key map receives mod for C-a");
+
+    win_key.str[0] = 0;
+    press_key(TICKIT_KEYEV_KEY, "a", 0);
+    press_key(TICKIT_KEYEV_KEY, "M-a", TICKIT_MOD_ALT);
+
+    is_str(win_key.str, "", "win key map does not receive a or M-a");
+
+    press_key(TICKIT_KEYEV_KEY, "Enter", 0);
+
+    is_str(subwin_key.str, "Enter", "subwin key map receives Enter");
+
+    next_idx = 0;
+    int bind_id = tickit_window_bind_event(win, TICKIT_WINDOW_ON_KEY, 0, &on_event_push, "win");
+    tickit_window_bind_key(otherwin, "F", 0, 0, &on_event_push, "otherwin");
+    tickit_window_bind_key(win, "F", 0, TICKIT_BIND_FIRST, &on_event_push, "win keymap");
+
+    press_key(TICKIT_KEYEV_TEXT, "F", 0);
+
+    is_int(next_idx, 3, "press_key pushes 3 strings for F");
+    is_str(ids[0], "win keymap", "ids[0] for F");
+    is_str(ids[1], "win",        "ids[1] for F");
+    is_str(ids[2], "otherwin",   "ids[2] for F");
+
+    tickit_window_unbind_event_id(win, bind_id);
+
+    int count = 0;
+    tickit_window_bind_key(otherwin, "G", 0, TICKIT_BIND_ONESHOT, &on_event_incr_int, &count);
+
+    press_key(TICKIT_KEYEV_TEXT, "G", 0);
+    press_key(TICKIT_KEYEV_TEXT, "G", 0);
+
+    is_int(count, 1, "ONESHOT key binding invoked once");
+
+    tickit_window_unbind_key_id(win, ca_id);
+
+    win_key.str[0] = 0;
+    press_key(TICKIT_KEYEV_KEY, "C-a", TICKIT_MOD_CTRL);
+
+    is_str(win_key.str, "", "win key map does not receive C-a after unbind");
+
+    /* Enough bindings to grow the map, then unbind every other one by ID */
+    int fkey_ids[20];
+    for(int i = 0; i < 20; i++) {
+      char name[8];
+      sprintf(name, "F%d", i + 1);
+      fkey_ids[i] = tickit_window_bind_key(otherwin, name, 0, 0, &on_event_incr_int, &count);
+    }
+    for(int i = 0; i < 20; i += 2)
+      tickit_window_unbind_key_id(otherwin, fkey_ids[i]);
+
+    count = 0;
+    press_key(TICKIT_KEYEV_KEY, "F1", 0);
+    press_key(TICKIT_KEYEV_KEY, "F19", 0);
+
+    is_int(count, 0, "key map does not receive keys unbound by ID");
+
+    press_key(TICKIT_KEYEV_KEY, "F2", 0);
+    press_key(TICKIT_KEYEV_KEY, "F20", 0);
+
+    is_int(count, 2, "key map still receives keys left bound");
+
+    count = 0;
+    tickit_window_bind_key(otherwin, "H", 0, TICKIT_BIND_DESTROY, &on_event_incr_int, &count);
+    tickit_window_unref(otherwin);
+    tickit_window_flush(root);
+
+    is_int(count, 1, "DESTROY key binding invoked on window destroy");
+  }
+
   tickit_window_unref(subwin);
 
   // Windows created in input events handlers don't receive events
@@ -0,0 +1,168 @@
+#include "tickit.h"
+#include "taplib.h"
+#include "taplib-tickit.h"
+#include "taplib-mockterm.h"
+
+#include <string.h>
+
+#define GRID_LINES 10
+#define GRID_COLS  8
+
+static TickitWindow *grid[GRID_LINES][GRID_COLS];
+static int expose_count[GRID_LINES][GRID_COLS];
+
+static TickitWindow *mouse_win;
+static TickitMouseEventInfo mouse_info;
+
+static int on_expose_count(TickitWindow *win, TickitEventFlags flags, void *_info, void *data)
+{
+  (*(int *)data)++;
+  return 1;
+}
+
+static int on_mouse_capture(TickitWindow *win, TickitEventFlags flags, void *_info, void *data)
+{
+  mouse_win  = win;
+  mouse_info = *(TickitMouseEventInfo *)_info;
+  return 1;
+}
+
+static int on_mouse_dismiss(TickitWindow *win, TickitEventFlags flags, void *_info, void *data)
+{
+  TickitWindow **winp = data;
+
+  tickit_window_close(*winp);
+  tickit_window_unref(*winp);
+  *winp = NULL;
+
+  return 0;
+}
+
+static int total_exposes(void)
+{
+  int total = 0;
+  for(int line = 0; line < GRID_LINES; line++)
+    for(int col = 0; col < GRID_COLS; col++)
+      total += expose_count[line][col];
+  return total;
+}
+
+int main(int argc, char *argv[])
+{
+  TickitTerm *tt = make_term(25, 80);
+  TickitWindow *root = tickit_window_new_root(tt);
+
+  ok(tickit_window_setctl_int(root, TICKIT_WINCTL_CHILD_INDEX, 1), "tickit_window_setctl_int TICKIT_WINCTL_CHILD_INDEX");
+
+  int value;
+  ok(tickit_window_getctl_int(root, TICKIT_WINCTL_CHILD_INDEX, &value) && value, "tickit_window_getctl_int TICKIT_WINCTL_CHILD_INDEX");
+
+  for(int line = 0; line < GRID_LINES; line++)
+    for(int col = 0; col < GRID_COLS; col++) {
+      TickitWindow *win = grid[line][col] =
+        tickit_window_new(root, (TickitRect){ .top = line * 2, .left = col * 10, .lines = 2, .cols = 10 }, 0);
+
+      tickit_window_bind_event(win, TICKIT_WINDOW_ON_EXPOSE, 0, &on_expose_count, &expose_count[line][col]);
+      tickit_window_bind_event(win, TICKIT_WINDOW_ON_MOUSE, 0, &on_mouse_capture, NULL);
+    }
+
+  tickit_window_flush(root);
+  is_int(total_exposes(), GRID_LINES * GRID_COLS, "every child exposed initially");
+
+  // Exposure only visits the children within the damage
+  {
+    memset(expose_count, 0, sizeof expose_count);
+
+    tickit_window_expose(root, &(TickitRect){ .top = 5, .left = 35, .lines = 1, .cols = 10 });
+    tickit_window_flush(root);
+
+    is_int(total_exposes(), 2, "two children exposed by damage");
+    ok(expose_count[2][3] && expose_count[2][4], "the children under the damage exposed");
+  }
+
+  // Hit-testing
+  {
+    press_mouse(TICKIT_MOUSEEV_PRESS, 1, 5, 35, 0);
+
+    ok(mouse_win == grid[2][3], "mouse press hits child under it");
+    is_int(mouse_info.line, 1, "mouse_info.line relative to child");
+    is_int(mouse_info.col,  5, "mouse_info.col relative to child");
+  }
+
+  // Stacking order is respected
+  {
+    TickitWindow *popup = tickit_window_new(root, (TickitRect){ .top = 4, .left = 30, .lines = 3, .cols = 20 }, 0);
+    tickit_window_bind_event(popup, TICKIT_WINDOW_ON_MOUSE, 0, &on_mouse_capture, NULL);
+    tickit_window_flush(root);
+
+    press_mouse(TICKIT_MOUSEEV_PRESS, 1, 5, 35, 0);
+    ok(mouse_win == popup, "mouse press hits frontmost child");
+
+    tickit_window_lower_to_back(popup);
+    tickit_window_flush(root);
+
+    press_mouse(TICKIT_MOUSEEV_PRESS, 1, 5, 35, 0);
+    ok(mouse_win == grid[2][3], "mouse press hits child above lowered popup");
+
+    tickit_window_raise_to_front(popup);
+    tickit_window_hide(popup);
+    tickit_window_flush(root);
+
+    press_mouse(TICKIT_MOUSEEV_PRESS, 1, 5, 35, 0);
+    ok(mouse_win == grid[2][3], "mouse press ignores hidden child");
+
+    tickit_window_close(popup);
+    tickit_window_unref(popup);
+    tickit_window_flush(root);
+  }
+
+  // Geometry changes are tracked
+  {
+    tickit_window_reposition(grid[0][0], 22, 0);
+    tickit_window_flush(root);
+
+    press_mouse(TICKIT_MOUSEEV_PRESS, 1, 22, 3, 0);
+    ok(mouse_win == grid[0][0], "mouse press hits moved child at new position");
+
+    mouse_win = NULL;
+    press_mouse(TICKIT_MOUSEEV_PRESS, 1, 0, 3, 0);
+    ok(mouse_win == NULL, "mouse press misses moved child at old position");
+  }
+
+  // Children stealing input see every mouse event
+  {
+    TickitWindow *thief = tickit_window_new(root, (TickitRect){ .top = 24, .left = 0, .lines = 1, .cols = 1 }, TICKIT_WINDOW_STEAL_INPUT);
+    tickit_window_bind_event(thief, TICKIT_WINDOW_ON_MOUSE, 0, &on_mouse_capture, NULL);
+    tickit_window_flush(root);
+
+    press_mouse(TICKIT_MOUSEEV_PRESS, 1, 5, 35, 0);
+    ok(mouse_win == thief, "mouse press goes to child stealing input");
+    is_int(mouse_info.line, -19, "mouse_info.line relative to thief");
+
+    tickit_window_unref(thief);
+  }
+
+  // Mouse handlers may destroy other children under the mouse
+  {
+    TickitWindow *dismisser = tickit_window_new(root, (TickitRect){ .top = 24, .left = 0, .lines = 1, .cols = 1 }, TICKIT_WINDOW_STEAL_INPUT);
+    tickit_window_bind_event(dismisser, TICKIT_WINDOW_ON_MOUSE, 0, &on_mouse_dismiss, &grid[2][3]);
+    tickit_window_flush(root);
+
+    mouse_win = NULL;
+    press_mouse(TICKIT_MOUSEEV_PRESS, 1, 5, 35, 0);
+    ok(!grid[2][3], "mouse handler destroyed child under the mouse");
+    ok(mouse_win == NULL, "destroyed child does not see the mouse press");
+
+    tickit_window_unref(dismisser);
+  }
+
+  for(int line = 0; line < GRID_LINES; line++)
+    for(int col = 0; col < GRID_COLS; col++)
+      if(grid[line][col])
+        tickit_window_unref(grid[line][col]);
+
+  tickit_window_unref(root);
+  tickit_term_unref(tt);
+
+  return exit_status();
+}
@@ -0,0 +1,144 @@
+#include "tickit.h"
+#include "taplib.h"
+#include "taplib-tickit.h"
+#include "taplib-mockterm.h"
+
+static int rendered;
+static int rendered_rows[16];
+
+static void render_row(TickitViewport *vp, const TickitViewportRowInfo *info, void *user)
+{
+  if(rendered < sizeof(rendered_rows)/sizeof(rendered_rows[0]))
+    rendered_rows[rendered] = info->row;
+  rendered++;
+
+  tickit_renderbuffer_textf_at(info->rb, 0, 0, "Row %d", info->row);
+}
+
+int main(int argc, char *argv[])
+{
+  TickitTerm *tt = make_term(25, 80);
+  TickitWindow *root = tickit_window_new_root(tt);
+
+  TickitWindow *win = tickit_window_new(root, (TickitRect){5, 0, 10, 80}, 0);
+  tickit_window_flush(root);
+  drain_termlog();
+
+  TickitViewport *vp = tickit_viewport_new(win, &render_row, NULL);
+
+  ok(!!vp, "tickit_viewport_new");
+  ok(tickit_viewport_get_window(vp) == win, "tickit_viewport_get_window");
+
+  tickit_viewport_set_content_size(vp, 1000000, 80);
+
+  int lines, cols;
+  tickit_viewport_get_content_size(vp, &lines, &cols);
+  is_int(lines, 1000000, "content lines");
+  is_int(cols,  80,      "content cols");
+
+  // Initial render
+  {
+    tickit_window_flush(root);
+
+    is_int(rendered, 10, "rendered 10 rows initially");
+    is_int(rendered_rows[0], 0, "first row rendered is 0");
+    is_int(rendered_rows[9], 9, "last row rendered is 9");
+
+    drain_termlog();
+  }
+
+  // Scrolling renders only the new rows
+  {
+    rendered = 0;
+    tickit_viewport_scroll(vp, 1, 0);
+    tickit_window_flush(root);
+
+    is_int(rendered, 1, "rendered 1 row after scroll by 1");
+    is_int(rendered_rows[0], 10, "rendered row 10 after scroll by 1");
+
+    is_termlog("Termlog after scroll by 1",
+        SETPEN(),
+        SCROLLRECT(5,0,10,80, 1,0),
+        GOTO(14,0), SETPEN(), PRINT("Row 10"), SETPEN(), ERASECH(74,-1),
+        NULL);
+
+    int line;
+    tickit_viewport_get_scroll(vp, &line, NULL);
+    is_int(line, 1, "scroll line after scroll by 1");
+
+    tickit_viewport_scroll(vp, 4, 0);
+    tickit_window_flush(root);
+
+    rendered = 0;
+    tickit_viewport_scroll(vp, -3, 0);
+    tickit_window_flush(root);
+
+    is_int(rendered, 3, "rendered 3 rows after scroll by -3");
+    is_int(rendered_rows[0], 2, "rendered row 2 after scroll by -3");
+
+    tickit_viewport_scroll(vp, -10, 0);
+    tickit_window_flush(root);
+
+    tickit_viewport_get_scroll(vp, &line, NULL);
+    is_int(line, 0, "scroll line clamped at top");
+
+    drain_termlog();
+  }
+
+  // Large jumps render only a window's worth
+  {
+    rendered = 0;
+    tickit_viewport_scroll_to(vp, 2000000, 0);
+    tickit_window_flush(root);
+
+    int line;
+    tickit_viewport_get_scroll(vp, &line, NULL);
+    is_int(line, 999990, "scroll line clamped at bottom");
+
+    is_int(rendered, 10, "rendered 10 rows after jump");
+    is_int(rendered_rows[0], 999990, "first row rendered after jump");
+    is_int(rendered_rows[9], 999999, "last row rendered after jump");
+
+    drain_termlog();
+  }
+
+  // Content changes
+  {
+    rendered = 0;
+    tickit_viewport_expose_rows(vp, 999995, 2);
+    tickit_window_flush(root);
+
+    is_int(rendered, 2, "rendered 2 rows after expose_rows");
+    is_int(rendered_rows[0], 999995, "first row rendered after expose_rows");
+
+    rendered = 0;
+    tickit_viewport_set_content_size(vp, 4, 80);
+    tickit_window_flush(root);
+
+    int line;
+    tickit_viewport_get_scroll(vp, &line, NULL);
+    is_int(line, 0, "scroll line clamped after shrinking content");
+    is_int(rendered, 4, "rendered 4 rows after shrinking content");
+
+    drain_termlog();
+
+    rendered = 0;
+    tickit_viewport_set_content_size(vp, 6, 80);
+    tickit_window_flush(root);
+
+    is_int(rendered, 2, "rendered 2 rows after growing content");
+    is_int(rendered_rows[0], 4, "first row rendered after growing content");
+
+    is_termlog("Termlog after growing content",
+        GOTO(9,0), SETPEN(), PRINT("Row 4"), SETPEN(), ERASECH(75,-1),
+        GOTO(10,0), SETPEN(), PRINT("Row 5"), SETPEN(), ERASECH(75,-1),
+        NULL);
+  }
+
+  tickit_viewport_destroy(vp);
+  tickit_window_unref(win);
+  tickit_window_unref(root);
+  tickit_term_unref(tt);
+
+  return exit_status();
+}
@@ -36,6 +36,18 @@ static int on_call_capture(Tickit *t, TickitEventFlags flags, void *info, void *
   return 1;
 }
 
+static int on_call_rearm(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  int *remainingp = user;
+
+  if(--(*remainingp))
+    tickit_watch_timer_after_msec(t, 0, 0, &on_call_rearm, remainingp);
+  else
+    tickit_stop(t);
+
+  return 1;
+}
+
 int main(int argc, char *argv[])
 {
   Tickit *t = tickit_new_for_term(tickit_mockterm_new(25, 80));
@@ -83,6 +95,16 @@ int main(int argc, char *argv[])
     is_int(state_b.capture, 1, "tickit_watch_timer_after_msec second capture");
   }
 
+  /* timers re-armed from their own callbacks reuse watch storage */
+  {
+    int remaining = 100;
+    tickit_watch_timer_after_msec(t, 0, 0, &on_call_rearm, &remaining);
+
+    tickit_run(t);
+
+    is_int(remaining, 0, "re-armed timer invoked repeatedly");
+  }
+
   /* timer cancellation */
   {
     void *watch = tickit_watch_timer_after_msec(t, 5, TICKIT_BIND_UNBIND, &on_call_incr, NULL);
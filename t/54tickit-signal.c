@@ -1,8 +1,19 @@
+#ifdef __GLIBC__
+#  define _XOPEN_SOURCE 600 // posix_openpt
+#endif
+
 #include "tickit.h"
 #include "tickit-mockterm.h"
 #include "taplib.h"
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
 
 static int unbound_count;
 static int on_call_incr(Tickit *t, TickitEventFlags flags, void *info, void *user)
@@ -19,6 +30,31 @@ static int on_call_incr(Tickit *t, TickitEventFlags flags, void *info, void *use
   return 1;
 }
 
+static int on_resize_count(TickitTerm *tt, TickitEventFlags flags, void *_info, void *user)
+{
+  TickitResizeEventInfo *info = _info;
+  int *ip = user;
+
+  ip[0]++;
+  ip[1] = info->lines;
+  ip[2] = info->cols;
+
+  return 1;
+}
+
+static void set_winsize(int fd, int lines, int cols)
+{
+  ioctl(fd, TIOCSWINSZ, &(struct winsize){ .ws_row = lines, .ws_col = cols });
+}
+
+static int thread_done;
+static void *run_tickit(void *data)
+{
+  tickit_run(data);
+  __atomic_store_n(&thread_done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
 int main(int argc, char *argv[])
 {
   Tickit *t = tickit_new_for_term(tickit_mockterm_new(25, 80));
@@ -38,6 +74,63 @@ int main(int argc, char *argv[])
     is_int(unbound_count, 1, "unbound_count after tickit_watch_cancel");
   }
 
+  /* every signal number, and without interrupting syscalls */
+  {
+    int called = 0;
+    void *w = tickit_watch_signal(t, SIGRTMAX, 0, &on_call_incr, &called);
+
+    ok(!!w, "tickit_watch_signal on SIGRTMAX");
+
+    struct sigaction act;
+    sigaction(SIGRTMAX, NULL, &act);
+    ok(act.sa_flags & SA_RESTART, "signal handler installed with SA_RESTART");
+
+    raise(SIGRTMAX);
+
+    tickit_run(t);
+
+    is_int(called, 1, "tickit_watch_signal on SIGRTMAX invokes callback");
+
+    tickit_watch_cancel(t, w);
+  }
+
+  /* multiple instances each see the signal */
+  {
+    Tickit *t2 = tickit_new_for_term(tickit_mockterm_new(25, 80));
+
+    int called = 0, called2 = 0;
+    void *w  = tickit_watch_signal(t,  SIGHUP, 0, &on_call_incr, &called);
+    void *w2 = tickit_watch_signal(t2, SIGHUP, 0, &on_call_incr, &called2);
+
+    raise(SIGHUP);
+
+    tickit_run(t);
+    tickit_run(t2);
+
+    is_int(called,  1, "first instance invokes callback");
+    is_int(called2, 1, "second instance invokes callback");
+
+    tickit_watch_cancel(t, w);
+    tickit_watch_cancel(t2, w2);
+
+    /* and from a loop on another thread */
+    called2 = 0;
+    tickit_watch_signal(t2, SIGHUP, 0, &on_call_incr, &called2);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, &run_tickit, t2);
+
+    while(!__atomic_load_n(&thread_done, __ATOMIC_ACQUIRE)) {
+      raise(SIGHUP);
+      usleep(1000);
+    }
+    pthread_join(thread, NULL);
+
+    is_int(called2, 1, "instance on another thread invokes callback");
+
+    tickit_unref(t2);
+  }
+
   /* object destruction */
   {
     tickit_watch_signal(t, SIGHUP, TICKIT_BIND_DESTROY, &on_call_incr, NULL);
@@ -49,5 +142,69 @@ int main(int argc, char *argv[])
     is_int(unbound_count, 1, "unbound_count after tickit_unref");
   }
 
+  /* SIGWINCH storms are throttled */
+  {
+    int master = posix_openpt(O_RDWR|O_NOCTTY);
+    if(master == -1 || grantpt(master) != 0 || unlockpt(master) != 0) {
+      perror("posix_openpt");
+      exit(1);
+    }
+    int slave = open(ptsname(master), O_RDWR|O_NOCTTY);
+    if(slave == -1) {
+      perror("open");
+      exit(1);
+    }
+    set_winsize(slave, 25, 80);
+
+    TickitTerm *tt = tickit_term_build(&(struct TickitTermBuilder){
+      .termtype  = "xterm",
+      .open      = TICKIT_OPEN_FDS,
+      .input_fd  = -1,
+      .output_fd = slave,
+    });
+    t = tickit_new_for_term(tt);
+
+    int resized[3] = { 0 };
+    tickit_term_bind_event(tt, TICKIT_TERM_ON_RESIZE, 0, &on_resize_count, resized);
+
+    tickit_setctl_int(t, TICKIT_CTL_RESIZE_THROTTLE_MSEC, 50);
+
+    set_winsize(slave, 30, 90);
+    raise(SIGWINCH);
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+
+    is_int(resized[0], 1, "first SIGWINCH applied immediately");
+    is_int(resized[1], 30, "resized lines after first SIGWINCH");
+
+    set_winsize(slave, 35, 100);
+    raise(SIGWINCH);
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+    set_winsize(slave, 40, 120);
+    raise(SIGWINCH);
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+
+    is_int(resized[0], 1, "later SIGWINCHes held while throttling");
+
+    while(resized[0] < 2)
+      tickit_tick(t, TICKIT_RUN_ONCE);
+
+    is_int(resized[1], 40, "resized lines after throttle interval");
+    is_int(resized[2], 120, "resized cols after throttle interval");
+
+    /* Let the throttle interval lapse */
+    usleep(60 * 1000);
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+
+    set_winsize(slave, 25, 80);
+    raise(SIGWINCH);
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+
+    is_int(resized[0], 3, "SIGWINCH after a quiet interval applied immediately");
+
+    tickit_unref(t);
+    close(slave);
+    close(master);
+  }
+
   return exit_status();
 }
@@ -64,6 +64,29 @@ int main(int argc, char *argv[])
     is_int(WEXITSTATUS(status), 10, "tickit_watch_process passes status to callback for pre-exit");
   }
 
+  /* multiple processes */
+  {
+    int status[3] = { 0 };
+    called_count = 0;
+
+    for(int i = 0; i < 3; i++) {
+      pid_t kid = fork();
+      if(kid == 0) {
+        usleep(10000 * (3 - i));
+        _exit(20 + i);
+      }
+
+      tickit_watch_process(t, kid, 0, &on_call_capture_status, &status[i]);
+    }
+
+    while(called_count < 3)
+      tickit_tick(t, 0);
+
+    is_int(called_count, 3, "tickit_watch_process invokes each callback once for multiple processes");
+    is_int(WEXITSTATUS(status[0]), 20, "first process status for multiple processes");
+    is_int(WEXITSTATUS(status[2]), 22, "last process status for multiple processes");
+  }
+
   /* object destruction */
   {
     /* We'll just make up a PID, it won't matter as we'll just cancel the
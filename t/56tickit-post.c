@@ -0,0 +1,127 @@
+#include "tickit.h"
+#include "tickit-mockterm.h"
+#include "taplib.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define NTHREADS 4
+#define NPOSTS   1000
+
+static int unbound_count;
+static int on_call_incr(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  if(flags & TICKIT_EV_FIRE) {
+    int *ip = user;
+    (*ip)++;
+  }
+  if(flags & TICKIT_EV_DESTROY)
+    unbound_count++;
+
+  return 1;
+}
+
+static int order[3], order_count;
+static int on_call_order(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  if(order_count < 3)
+    order[order_count++] = *(int *)user;
+
+  return 1;
+}
+
+static int received[NTHREADS];
+static int last_seen[NTHREADS];
+static int out_of_order;
+static int on_call_thread(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  int seq = (int)(intptr_t)user;
+  int thread = seq / NPOSTS;
+
+  if(seq % NPOSTS != last_seen[thread] + 1)
+    out_of_order++;
+  last_seen[thread] = seq % NPOSTS;
+
+  received[thread]++;
+  return 1;
+}
+
+static void *run_thread(void *data)
+{
+  Tickit *t = data;
+  static int next_thread;
+  int thread = __atomic_fetch_add(&next_thread, 1, __ATOMIC_RELAXED);
+
+  for(int i = 0; i < NPOSTS; i++)
+    tickit_post(t, 0, &on_call_thread, (void *)(intptr_t)(thread * NPOSTS + i));
+
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  Tickit *t = tickit_new_for_term(tickit_mockterm_new(25, 80));
+
+  {
+    int called = 0;
+    ok(tickit_post(t, 0, &on_call_incr, &called), "tickit_post returns true");
+
+    is_int(called, 0, "tickit_post does not invoke callback immediately");
+
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+
+    is_int(called, 1, "tickit_post invokes callback");
+  }
+
+  /* ordering */
+  {
+    int values[3] = { 1, 2, 3 };
+    for(int i = 0; i < 3; i++)
+      tickit_post(t, 0, &on_call_order, &values[i]);
+
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+
+    is_int(order_count, 3, "all posted callbacks invoked in one tick");
+    ok(order[0] == 1 && order[1] == 2 && order[2] == 3, "posted callbacks invoked in order");
+  }
+
+  /* other threads */
+  {
+    pthread_t threads[NTHREADS];
+    for(int i = 0; i < NTHREADS; i++) {
+      last_seen[i] = -1;
+      pthread_create(&threads[i], NULL, &run_thread, t);
+    }
+
+    int total = 0;
+    while(total < NTHREADS * NPOSTS) {
+      tickit_tick(t, TICKIT_RUN_ONCE);
+
+      total = 0;
+      for(int i = 0; i < NTHREADS; i++)
+        total += received[i];
+    }
+
+    for(int i = 0; i < NTHREADS; i++)
+      pthread_join(threads[i], NULL);
+
+    is_int(total, NTHREADS * NPOSTS, "all callbacks posted from other threads invoked");
+    is_int(out_of_order, 0, "callbacks from each thread invoked in order");
+  }
+
+  /* object destruction */
+  {
+    int called = 0;
+    tickit_post(t, TICKIT_BIND_DESTROY, &on_call_incr, &called);
+    tickit_post(t, 0, &on_call_incr, &called);
+
+    unbound_count = 0;
+
+    tickit_unref(t);
+
+    is_int(called, 0, "posted callbacks not fired after tickit_unref");
+    is_int(unbound_count, 1, "unbound_count after tickit_unref");
+  }
+
+  return exit_status();
+}
@@ -0,0 +1,150 @@
+#include "tickit.h"
+#include "tickit-mockterm.h"
+#include "taplib.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+static pthread_t loop_thread;
+
+struct Job {
+  int input, output;
+  bool on_worker;
+  int done;
+};
+
+static void do_square(void *user)
+{
+  struct Job *job = user;
+  job->on_worker = !pthread_equal(pthread_self(), loop_thread);
+  job->output = job->input * job->input;
+}
+
+struct MaskJob {
+  sigset_t mask;
+  int done;
+};
+
+static void do_getmask(void *user)
+{
+  struct MaskJob *job = user;
+  pthread_sigmask(SIG_BLOCK, NULL, &job->mask);
+}
+
+static int on_mask_done(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  struct MaskJob *job = user;
+  job->done++;
+  return 1;
+}
+
+static int unbound_count;
+static int on_done(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  struct Job *job = user;
+  if(flags & TICKIT_EV_FIRE) {
+    job->done++;
+    if(!pthread_equal(pthread_self(), loop_thread))
+      job->done = -1;
+  }
+  if(flags & TICKIT_EV_UNBIND)
+    unbound_count++;
+
+  return 1;
+}
+
+static pthread_mutex_t gate = PTHREAD_MUTEX_INITIALIZER;
+static void do_blocked(void *user)
+{
+  pthread_mutex_lock(&gate);
+  pthread_mutex_unlock(&gate);
+}
+
+int main(int argc, char *argv[])
+{
+  Tickit *t = tickit_new_for_term(tickit_mockterm_new(25, 80));
+  loop_thread = pthread_self();
+
+  ok(tickit_setctl_int(t, TICKIT_CTL_WORKER_THREADS, 1), "tickit_setctl_int TICKIT_CTL_WORKER_THREADS");
+
+  {
+    struct Job job = { .input = 7 };
+    void *w = tickit_watch_work(t, 0, &do_square, &on_done, &job);
+    ok(!!w, "tickit_watch_work returns watch");
+
+    while(!job.done)
+      tickit_tick(t, TICKIT_RUN_ONCE);
+
+    is_int(job.done, 1, "fn_done invoked once on the loop thread");
+    is_int(job.output, 49, "work function result visible to fn_done");
+    ok(job.on_worker, "work function invoked on a worker thread");
+
+    ok(!tickit_setctl_int(t, TICKIT_CTL_WORKER_THREADS, 4), "TICKIT_CTL_WORKER_THREADS fixed once started");
+  }
+
+  /* cancellation */
+  {
+    /* Hold the only worker busy so the next work stays queued */
+    pthread_mutex_lock(&gate);
+    struct Job blocker = { 0 };
+    void *wb = tickit_watch_work(t, TICKIT_BIND_UNBIND, &do_blocked, &on_done, &blocker);
+
+    struct Job job = { .input = 3 };
+    void *w = tickit_watch_work(t, TICKIT_BIND_UNBIND, &do_square, &on_done, &job);
+
+    unbound_count = 0;
+
+    tickit_watch_cancel(t, w);
+    is_int(unbound_count, 1, "unbound_count after tickit_watch_cancel of queued work");
+
+    /* Give the worker every chance to take the blocker before cancelling it */
+    usleep(10000);
+    tickit_watch_cancel(t, wb);
+    is_int(unbound_count, 2, "unbound_count after tickit_watch_cancel of running work");
+
+    pthread_mutex_unlock(&gate);
+
+    /* Flush a final job through the single worker to be sure both are gone */
+    struct Job after = { .input = 2 };
+    tickit_watch_work(t, 0, &do_square, &on_done, &after);
+    while(!after.done)
+      tickit_tick(t, TICKIT_RUN_ONCE);
+
+    is_int(job.output, 0, "cancelled queued work not run");
+    is_int(job.done + blocker.done, 0, "cancelled work does not invoke fn_done");
+  }
+
+  /* signals are kept off the workers */
+  {
+    struct MaskJob job = { .done = 0 };
+    sigemptyset(&job.mask);
+    tickit_watch_work(t, 0, &do_getmask, &on_mask_done, &job);
+
+    while(!job.done)
+      tickit_tick(t, TICKIT_RUN_ONCE);
+
+    ok(sigismember(&job.mask, SIGWINCH) && sigismember(&job.mask, SIGCHLD), "signals blocked on worker thread");
+
+    sigset_t mask;
+    pthread_sigmask(SIG_BLOCK, NULL, &mask);
+    ok(!sigismember(&mask, SIGWINCH), "signals not blocked on loop thread");
+  }
+
+  /* object destruction */
+  {
+    pthread_mutex_lock(&gate);
+    struct Job blocker = { 0 }, job = { .input = 5 };
+    tickit_watch_work(t, TICKIT_BIND_DESTROY, &do_blocked, &on_done, &blocker);
+    tickit_watch_work(t, TICKIT_BIND_DESTROY, &do_square, &on_done, &job);
+    pthread_mutex_unlock(&gate);
+
+    unbound_count = 0;
+
+    tickit_unref(t);
+
+    is_int(unbound_count, 2, "unbound_count after tickit_unref");
+  }
+
+  return exit_status();
+}
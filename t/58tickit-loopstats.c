@@ -0,0 +1,62 @@
+#include "tickit.h"
+#include "tickit-mockterm.h"
+#include "taplib.h"
+
+#include <unistd.h>
+
+static int on_timer_slow(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  usleep(2000);
+  return 0;
+}
+
+static int on_later(Tickit *t, TickitEventFlags flags, void *info, void *user)
+{
+  tickit_stop(t);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  Tickit *t = tickit_new_for_term(tickit_mockterm_new(25, 80));
+  TickitLoopStatInfo info;
+
+  ok(!tickit_get_loopstat(t, TICKIT_LOOPSTAT_TIMER, &info), "tickit_get_loopstat fails before enabling");
+
+  int value;
+  ok(tickit_getctl_int(t, TICKIT_CTL_LOOPSTATS, &value) && !value, "TICKIT_CTL_LOOPSTATS initially disabled");
+
+  ok(tickit_setctl_int(t, TICKIT_CTL_LOOPSTATS, 1), "tickit_setctl_int TICKIT_CTL_LOOPSTATS");
+
+  tickit_watch_timer_after_msec(t, 1, 0, &on_timer_slow, NULL);
+  tickit_watch_timer_after_msec(t, 5, 0, &on_later, NULL);
+
+  tickit_run(t);
+
+  ok(tickit_get_loopstat(t, TICKIT_LOOPSTAT_TIMER, &info), "tickit_get_loopstat TIMER");
+  is_int(info.count, 2, "TIMER count");
+  ok(info.max_usec >= 2000, "TIMER max_usec includes slow callback");
+  ok(info.slowest == &on_timer_slow, "TIMER slowest identifies the slow callback");
+  ok(info.p99_usec >= info.p50_usec && info.p99_usec <= info.max_usec, "TIMER percentiles ordered");
+
+  ok(tickit_get_loopstat(t, TICKIT_LOOPSTAT_POLL, &info), "tickit_get_loopstat POLL");
+  ok(info.count > 0, "POLL count");
+
+  ok(tickit_get_loopstat(t, TICKIT_LOOPSTAT_ITERATION, &info), "tickit_get_loopstat ITERATION");
+  ok(info.count > 0 && info.max_usec >= 2000, "ITERATION includes slow callback");
+
+  /* disabling stops recording but keeps the results */
+  tickit_setctl_int(t, TICKIT_CTL_LOOPSTATS, 0);
+
+  tickit_watch_timer_after_msec(t, 0, 0, &on_later, NULL);
+  tickit_run(t);
+
+  tickit_get_loopstat(t, TICKIT_LOOPSTAT_TIMER, &info);
+  is_int(info.count, 2, "TIMER count unchanged while disabled");
+
+  is_str(tickit_loopstat_name(TICKIT_LOOPSTAT_IO), "io", "tickit_loopstat_name");
+
+  tickit_unref(t);
+
+  return exit_status();
+}
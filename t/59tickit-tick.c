@@ -2,6 +2,8 @@
 #include "tickit-mockterm.h"
 #include "taplib.h"
 
+#include <unistd.h>
+
 static int on_call_incr(Tickit *t, TickitEventFlags flags, void *info, void *user)
 {
   if(flags & TICKIT_EV_FIRE) {
@@ -12,6 +14,18 @@ static int on_call_incr(Tickit *t, TickitEventFlags flags, void *info, void *use
   return 1;
 }
 
+static int on_expose_incr(TickitWindow *win, TickitEventFlags flags, void *info, void *user)
+{
+  int *ip = user;
+  (*ip)++;
+
+  return 1;
+}
+
+static void output_discard(TickitTerm *tt, const char *bytes, size_t len, void *user)
+{
+}
+
 int main(int argc, char *argv[])
 {
   Tickit *t = tickit_new_for_term(tickit_mockterm_new(25, 80));
@@ -34,5 +48,51 @@ int main(int argc, char *argv[])
 
   tickit_unref(t);
 
+  // Root flush waits while terminal input is pending
+  {
+    int fds[2];
+    if(pipe(fds) != 0) {
+      perror("pipe");
+      exit(1);
+    }
+
+    TickitTerm *tt = tickit_term_build(&(struct TickitTermBuilder){
+      .termtype    = "xterm",
+      .open        = TICKIT_OPEN_FDS,
+      .input_fd    = fds[0],
+      .output_fd   = -1,
+      .output_func = output_discard,
+    });
+    t = tickit_new_for_term(tt);
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+
+    TickitWindow *root = tickit_get_rootwin(t);
+    tickit_window_setctl_int(root, TICKIT_WINCTL_INPUT_DEFER_MSEC, 10000);
+
+    int exposed = 0;
+    tickit_window_bind_event(root, TICKIT_WINDOW_ON_EXPOSE, 0, &on_expose_incr, &exposed);
+
+    tickit_window_expose(root, NULL);
+    write(fds[1], "A", 1);
+
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+    is_int(exposed, 0, "root not flushed while input was pending");
+
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+    is_int(exposed, 1, "root flushed once input was read");
+
+    tickit_window_setctl_int(root, TICKIT_WINCTL_INPUT_DEFER_MSEC, 0);
+
+    tickit_window_expose(root, NULL);
+    write(fds[1], "A", 1);
+
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+    is_int(exposed, 2, "root flushed despite pending input with INPUT_DEFER_MSEC 0");
+
+    tickit_unref(t);
+    close(fds[0]);
+    close(fds[1]);
+  }
+
   return exit_status();
 }